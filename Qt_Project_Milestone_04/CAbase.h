@@ -1,10 +1,28 @@
 #ifndef CABASE_H
 #define CABASE_H
 
+#include <math.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
 #include <ctime>
-#include <qmath.h>
-#include <QtDebug>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "arena.h"
+#include "bitplane.h"
+#include "lifekernel.h"
+#include "philox.h"
+#include "rules.h"
+#include "threadpool.h"
+#include "zobrist.h"
+
+// the core needs no Qt; define CA_SNAKE_TRACE (DEFINES in the .pro) to trace the snake on stderr
+
+class CAview;
 
 class CAbase {
 
@@ -12,18 +30,77 @@ public:
     CAbase() :
         Ny(10),
         Nx(10),
-        nochanges(false)
+        world(nullptr),
+        worldNew(nullptr),
+        worldSlot(nullptr),
+        freeCells(nullptr),
+        freeCount(0),
+        snakeSerial(0),
+        worldLifetime(nullptr),
+        worldLifetimeNew(nullptr),
+        worldDirection(nullptr),
+        worldClaim(nullptr),
+        nochanges(false),
+        universeMode(0),
+        borderMode(BorderTorus),
+        tileWidth(defaultTileWidth),
+        packedStorage(true),
+        packed(false),
+        snake(false),
+        rule(makeRule(RULE_LIFE)),
+        seed(uint64_t(time(NULL))),
+        generation(0),
+        worldHash(0),
+        hashValid(false),
+        cycleDetection(true),
+        hashCount(0),
+        cyclePeriod(0),
+        cycleStart(0)
         { resetWorldSize(Nx, Ny, 1); }
 
     CAbase(int nx, int ny) :
         Ny(ny),
         Nx(nx),
-        nochanges(false)
+        world(nullptr),
+        worldNew(nullptr),
+        worldSlot(nullptr),
+        freeCells(nullptr),
+        freeCount(0),
+        snakeSerial(0),
+        worldLifetime(nullptr),
+        worldLifetimeNew(nullptr),
+        worldDirection(nullptr),
+        worldClaim(nullptr),
+        nochanges(false),
+        universeMode(0),
+        borderMode(BorderTorus),
+        tileWidth(defaultTileWidth),
+        packedStorage(true),
+        packed(false),
+        snake(false),
+        rule(makeRule(RULE_LIFE)),
+        seed(uint64_t(time(NULL))),
+        generation(0),
+        worldHash(0),
+        hashValid(false),
+        cycleDetection(true),
+        hashCount(0),
+        cyclePeriod(0),
+        cycleStart(0)
         { resetWorldSize(Nx, Ny, 1); }
 
+    // the automaton owns its planes: it can neither be copied nor moved, use view() to read it and
+    // adoptUniverse() to hand a universe over
+    CAbase(const CAbase &) = delete;
+    CAbase &operator=(const CAbase &) = delete;
+    CAbase(CAbase &&) = delete;
+    CAbase &operator=(CAbase &&) = delete;
+
     ~CAbase() {
     }
 
+    CAview view() const;
+
     int getNy() {
         return Ny;
     }
@@ -32,23 +109,8 @@ public:
         return Nx;
     }
 
-    int getColor(int x, int y) {
-        // get color of cell x, y
-        return worldColor[y * (Nx + 2) + x];
-    }
-
-    void setColor(int x, int y, int c) {
-        // set color c into cell x, y in current color universe
-        worldColor[y * (Nx + 2) + x] = c;
-    }
-
-    void setColorNew(int x, int y, int c){
-        // set color c into cell with coordinates x,y in evolution color universe
-        worldColorNew[y * (Nx + 2) + x] = c;
-    }
-
     int getLifetime(int x, int y) {
-        // get lifetime of cell x, y
+        // get lifetime of cell x, y (predator-prey only)
         return worldLifetime[y * (Nx + 2) + x];
     }
 
@@ -63,20 +125,41 @@ public:
     }
 
     int getValue(int x, int y) {
+        if (packed) return bits.get(x, y);
+        if (snake) return getSnakeValue(y * (Nx + 2) + x);
         return world[y * (Nx + 2) + x];
     }
 
     void setValue(int x, int y, int i) {
         // set number i into cell with coordinates x,y in current universe
-        world[y * (Nx + 2) + x] = i;
+        if (packed) bits.set(x, y, i);
+        else if (snake) setSnakeValue(y * (Nx + 2) + x, i);
+        else world[y * (Nx + 2) + x] = i;
+        hashValid = false;
+    }
+
+    void setRow(int y, const uint64_t *cells) {
+        /* interior cells of row y from a bit row, cell x at bit x - 1 (binary modes only) */
+
+        if (packed) {
+            uint64_t *r = bits.row(y);
+            memcpy(r, cells, bits.getWords() * sizeof(uint64_t));
+            r[bits.getWords() - 1] &= bits.lastWordMask();
+        } else {
+            int8_t *r = &world[y * (Nx + 2)];
+            for (int x = 1; x <= Nx; x++) r[x] = (cells[(x - 1) >> 6] >> ((x - 1) & 63)) & 1;
+        }
+        hashValid = false;
     }
 
     void setValueNew(int x, int y, int i) {
         // set number i into cell with coordinates x,y in evolution universe
-        worldNew[y * (Nx + 2) + x] = i;
+        if (packed) bitsNew.set(x, y, i);
+        else worldNew[y * (Nx + 2) + x] = i;
     }
 
     int getDirection(int x, int y) {
+        // predator-prey only
         return worldDirection[y * (Nx + 2) + x];
     }
 
@@ -84,12 +167,240 @@ public:
         worldDirection[y * (Nx + 2) + x] = i;
     }
 
+    int getClaim(int x, int y) {
+        // predator-prey only: neighbour 1 .. 4 (down, left, right, up) that moves into x, y, or 0
+        return worldClaim[y * (Nx + 2) + x];
+    }
+
     bool isNotChanged() {
         return nochanges;
     }
 
+    int getUniverseMode() {
+        return universeMode;
+    }
+
+    void setUniverseMode(int m) {
+        // takes effect with the next resetWorldSize
+        universeMode = m;
+    }
+
+    void setPackedStorage(bool p) {
+        // bit-packed planes for the binary modes (default), int planes otherwise; takes effect with the next resetWorldSize
+        packedStorage = p;
+    }
+
+    bool isPacked() {
+        return packed;
+    }
+
+    bool getPackedStorage() {
+        return packedStorage;
+    }
+
+    static bool isBinaryMode(int m) {
+        // Life, Noise, Erosion, Fluids, Gases and custom rules only ever hold 0 or 1
+        return m == 0 || (m >= 3 && m <= 7);
+    }
+
+    static bool isCellValue(int m, int v) {
+        // values an interior cell of mode m holds in memory; the snake keeps its segments in worldSlot
+        if (m == 1) return v == 0 || v == 5 || v == 10;
+        if (m == 2) return v == 0 || v == 1 || v == 2 || v == 5;
+        return v == 0 || v == 1;
+    }
+
+    // largest edge length of a universe: bit planes index rows with size_t, while the cells of
+    // int planes are indexed with int, (Nx + 2) * (Ny + 2) < 2^31
+    static const int maxPackedSize = 65536;
+    static const int maxIntSize = 46338;
+
+    int getMaxSize(int m) {
+        // largest edge length of a universe of mode m with the current storage setting
+        return (packedStorage && isBinaryMode(m)) ? maxPackedSize : maxIntSize;
+    }
+
+    void setHugePages(bool h) {
+        // back large universes with transparent huge pages (default); takes effect with the next resetWorldSize
+        arena.setHugePages(h);
+    }
+
+    size_t getStorageBytes() {
+        // bytes reserved for the cell planes of the current mode
+        return arena.getCapacity();
+    }
+
     void resetWorldSize(int nx, int ny, bool del = 0);
 
+    void adoptUniverse(CAbase &other);
+
+    // SNAPSHOT
+    bool saveSnapshot(const char *path);
+
+    bool loadSnapshot(const char *path, int mode = -1);
+
+    void worldEvolution();
+
+    uint64_t evolveGenerations(uint64_t n);
+
+    // BORDER
+    enum borderModes {
+        BorderTorus, // opposite edges are neighbours
+        BorderWall   // cells outside the universe are dead
+    };
+
+    int getBorderMode() {
+        return borderMode;
+    }
+
+    void setBorderMode(int b) {
+        borderMode = b;
+        hashValid = false;
+    }
+
+    void fillHalo();
+
+    template <class T>
+    void fillHalo(T *plane);
+
+    // TRAVERSAL
+    static const int defaultTileWidth = 1024; // cells per tile row, a multiple of a cache line
+
+    int getTileWidth() {
+        return tileWidth;
+    }
+
+    void setTileWidth(int w) {
+        // a tile width of 1 visits the cells column by column
+        tileWidth = w;
+    }
+
+    template <class F>
+    void sweep(F cellEvolution);
+
+    template <class F>
+    void sweepRows(int y0, int y1, F cellEvolution);
+
+    // THREADS
+    int getThreadCount() {
+        return pool ? pool->getThreadCount() : 1;
+    }
+
+    void setThreadCount(int n) {
+        // worker threads for every mode but Snake; 1 runs everything on the calling thread
+        if (n < 1) n = 1;
+        if (n == getThreadCount()) return;
+        if (!pool) pool.reset(new ThreadPool(n));
+        else pool->setThreadCount(n);
+    }
+
+    template <class F>
+    uint64_t reduceBands(F band);
+
+    template <class F>
+    uint64_t reduceBands(int y0, int y1, F band);
+
+    template <class F>
+    bool sweepParallel(F cellEvolution);
+
+    template <class F>
+    bool sweepHashed(F cellEvolution);
+
+    // RANDOM NUMBERS
+    enum randomPurposes {
+        RandomDirection,   // predator-prey: direction a cell moves in
+        RandomClaim,       // predator-prey: priority of a cell among all cells moving to the same target
+        RandomGases,       // rotation sense of the Margolus blocks, one bit per block
+        RandomFood,        // snake: position of the next piece of food
+        RandomNoise        // initial noise
+    };
+
+    uint64_t getSeed() {
+        return seed;
+    }
+
+    void setSeed(uint64_t s) {
+        // the same seed reproduces the same run, whatever engine or thread count evolves it
+        seed = s;
+    }
+
+    uint64_t getGeneration() {
+        return generation;
+    }
+
+    void setGeneration(uint64_t g) {
+        generation = g;
+        hashValid = false;
+    }
+
+    uint64_t cellRandom(int x, int y, int purpose) {
+        // 64 random bits that only depend on seed, generation, x, y and purpose
+        return philox(seed, generation, x, y, purpose);
+    }
+
+    // CYCLE DETECTION
+    static const int cycleHistoryLength = 1024; // longest period that is detected, a power of two
+
+    static bool isCycleMode(int m) {
+        // modes whose next generation only depends on the current one: Life, Noise, Erosion, Fluids and custom rules
+        return m == 0 || m == 3 || m == 4 || m == 5 || m == 7;
+    }
+
+    bool getCycleDetection() {
+        return cycleDetection;
+    }
+
+    void setCycleDetection(bool c) {
+        // hash every generation of the cycle modes to find cycles (default), at some cost for chaotic universes
+        cycleDetection = c;
+        hashValid = false;
+        cyclePeriod = 0;
+    }
+
+    uint64_t getCyclePeriod() {
+        // period of the cycle the universe has entered, 0 if none was found (yet)
+        return cyclePeriod;
+    }
+
+    uint64_t getCycleStart() {
+        // first generation of the cycle
+        return cycleStart;
+    }
+
+    uint64_t hashRow(int iy, bool next);
+
+    uint64_t rehashRow(int iy);
+
+    uint64_t hashWorld();
+
+    void resetCycle();
+
+    void trackCycle();
+
+    // DOUBLE BUFFERING
+    int8_t *front() {
+        // current generation
+        return world;
+    }
+
+    int8_t *back() {
+        // next generation, written by the evolution passes
+        return worldNew;
+    }
+
+    void swapBuffers() {
+        /* publish the next generation by swapping the current and new planes instead of copying them */
+        std::swap(world, worldNew);
+        std::swap(worldLifetime, worldLifetimeNew);
+        bits.swap(bitsNew);
+    }
+
+    // BIT-PACKED EVOLUTION
+    template <class R>
+    void worldEvolutionBits(R rowEvolution);
+
+    void worldEvolutionGasesBits();
+
     // GAME OF LIFE
     int cellEvolutionLife(int x, int y);
 
@@ -124,6 +435,19 @@ public:
         snakeAction = a;
     }
 
+    int getSnakeValue(size_t i) {
+        // 10 + k for the k-th body segment behind the head
+        return world[i] == 10 ? 10 + int(snakeSerial - worldSlot[i]) : world[i];
+    }
+
+    void setSnakeValue(size_t i, int v);
+
+    void freeCellAdd(uint32_t i);
+
+    void freeCellRemove(uint32_t i);
+
+    void snakeRingReserve(size_t n);
+
     void calcSnakeAction();
 
     void worldEvolutionSnake();
@@ -132,12 +456,14 @@ public:
 
     void putInitSnake();
 
+    bool rebuildSnake();
+
     // PREDATOR
-    const int maxLifetime = __INT16_MAX__;
+    static const int maxLifetime = __INT16_MAX__;
 
     int lifeTimeUI;
 
-    void cellEvolutionConsistency(int x, int y);
+    void cellEvolutionClaim(int x, int y);
 
     void cellEvolutionMove(int x, int y);
 
@@ -146,8 +472,6 @@ public:
     void worldEvolutionPredator();
 
     // NOISE
-    position torifyPosition(position inPos);
-
     void generateInitRandomNoise();
 
     void cellEvolutionNoise(int x, int y);
@@ -165,87 +489,767 @@ public:
     void worldEvolutionFluids();
 
     // GASES
-    void cellEvolutionGases(int x, int y);
+    int cellEvolutionGases(int x, int y, bool ccw);
+
+    void settleCell(int x, int y, uint64_t &changed);
 
     void worldEvolutionGases();
 
+    // CUSTOM RULE
+    LifeRule getRule() {
+        return rule;
+    }
+
+    void setRule(LifeRule r) {
+        // outer-totalistic rule of the custom rule mode
+        rule = r;
+        hashValid = false;
+    }
+
+    void cellEvolutionRule(int x, int y);
+
+    void worldEvolutionRule();
+
 private:
+    size_t layoutBytes();
+
+    void takePlanes(bool filled);
+
+    // header padded to snapshotAlignment, then the raw image of the arena, so that it can be mapped
+    // as is; the ring, length, head and food of the snake are rebuilt from its body when it is loaded
+    struct SnapshotHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder;      // snapshotByteOrder as written by the saving machine
+        uint64_t headerBytes;    // offset of the arena image
+        uint64_t planeBytes;     // arena image
+        int32_t universeMode;
+        int32_t nx;
+        int32_t ny;
+        int32_t packed;
+        int32_t borderMode;
+        int32_t nochanges;
+        int32_t snakeAction;
+        int32_t directionPast;
+        int32_t directionFuture;
+        uint32_t snakeSerial;
+        uint16_t birth;
+        uint16_t survival;
+        uint64_t seed;
+        uint64_t generation;
+        uint64_t world;          // offsets of the current planes in the arena, which may be either of a pair
+        uint64_t lifetime;
+        uint64_t bits;
+    };
+
+    static const uint32_t snapshotVersion = 1;
+    static const uint32_t snapshotByteOrder = 0x01020304;
+    static const size_t snapshotAlignment = 65536; // a multiple of the page size on all common systems
+
     int Ny;
     int Nx;
-    int *world;
-    int *worldNew;
-    int *worldColor;
-    int *worldColorNew;
-    int *worldLifetime;
-    int *worldLifetimeNew;
-    int *worldDirection;
+    Arena arena;             // single block holding all planes below
+    int8_t *world;           // cell values
+    int8_t *worldNew;
+    uint32_t *worldSlot;     // snake only: serial number of a body segment, or position of an empty cell in freeCells
+    uint32_t *freeCells;     // snake only: all empty cells, so that food is placed in O(1)
+    size_t freeCount;
+    std::vector<uint32_t> snakeRing; // snake only: cell of every body segment at serial & (size - 1)
+    uint32_t snakeSerial;    // serial number of the head, one more for every step
+    int16_t *worldLifetime;  // predator-prey only
+    int16_t *worldLifetimeNew;
+    int8_t *worldDirection;  // predator-prey only
+    int8_t *worldClaim;      // predator-prey only
     bool nochanges;
     int snakeAction;
     int snakeLength;
+    int universeMode;
+    int borderMode;
+    int tileWidth;
+    bool packedStorage;
+    bool packed;
+    bool snake;
+    BitPlane bits;
+    BitPlane bitsNew;
+    std::unique_ptr<ThreadPool> pool;
+    LifeRule rule;
+    uint64_t seed;
+    uint64_t generation;     // generations evolved since the last resetWorldSize
+    uint64_t worldHash;      // Zobrist hash of the current generation, updated by the evolution of the cycle modes
+    std::vector<uint64_t> rowHash; // hash of every row, the world hash is their XOR
+    bool hashValid;          // cleared by every change from outside the evolution
+    bool cycleDetection;
+    std::vector<uint64_t> hashHistory; // hash of generation g at g % cycleHistoryLength
+    std::vector<uint16_t> hashFilter;  // number of hashes in the history by their lowest bits
+    uint64_t hashCount;      // generations in the history
+    uint64_t cyclePeriod;
+    uint64_t cycleStart;
 };
 
 
 inline void CAbase::resetWorldSize(int nx, int ny, bool del) {
     /* main function to reset the cellular automata */
 
-    // initialize randomization
-    srand(time(NULL));
+    // random numbers restart from the first generation of the current seed
+    generation = 0;
+    hashValid = false;
+    cyclePeriod = 0;
 
     // creation or re-creation of current and new universe with default values (0 for non-border cell and -1 for border cell)
     Nx = nx;
     Ny = ny;
+    packed = packedStorage && isBinaryMode(universeMode);
+    snake = (universeMode == 1);
+    bool predator = (universeMode == 2);
 
     if (!del) {
-        delete[] world;
-        delete[] worldNew;
+        arena.release();
+    }
 
-        delete[] worldColor;
-        delete[] worldColorNew;
+    freeCount = 0;
+    snakeRing.clear();
+    snakeSerial = 0;
 
-        delete[] worldLifetime;
-        delete[] worldLifetimeNew;
+    // only the planes the active mode reads are allocated, each at its natural width
+    arena.reserve(layoutBytes());
+    takePlanes(false);
+    if (packed) return;
 
-        delete[] worldDirection;
+    size_t cells = (size_t) (Ny + 2) * (Nx + 2);
+    for (size_t i = 0; i < cells; i++) {
+        // set border cells to -1 (still involving modular arithmetic -> toric case)
+        bool border = (i < size_t(Nx + 2)) || (i >= cells - (Nx + 2)) || (i % (Nx + 2) == 0) || (i % (Nx + 2) == size_t(Nx + 1));
+        world[i] = border ? -1 : 0;
+        if (worldNew) worldNew[i] = border ? -1 : 0;
+        if (snake && !border) freeCellAdd(i);
+        if (predator) {
+            worldLifetime[i] = border ? -1 : maxLifetime;
+            worldLifetimeNew[i] = border ? -1 : maxLifetime;
+            worldDirection[i] = border ? -1 : 0;
+            worldClaim[i] = 0;
+        }
     }
+}
 
-    world = new int[(Ny + 2) * (Nx + 2) + 1];
-    worldNew = new int[(Ny + 2) * (Nx + 2) + 1];
 
-    worldColor = new int[(Ny + 2) * (Nx + 2) + 1];
-    worldColorNew = new int[(Ny + 2) * (Nx + 2) + 1];
 
-    worldLifetime = new int[(Ny + 2) * (Nx + 2) + 1];
-    worldLifetimeNew = new int[(Ny + 2) * (Nx + 2) + 1];
+inline void CAbase::adoptUniverse(CAbase &other) {
+    /* take over the universe of other, such as a file decoded and checked in full, keeping the settings
+     * of this automaton (threads, storage, border, rule); other is left with the previous universe */
+
+    std::swap(Nx, other.Nx);
+    std::swap(Ny, other.Ny);
+    arena.swap(other.arena);
+    std::swap(world, other.world);
+    std::swap(worldNew, other.worldNew);
+    std::swap(worldSlot, other.worldSlot);
+    std::swap(freeCells, other.freeCells);
+    std::swap(freeCount, other.freeCount);
+    snakeRing.swap(other.snakeRing);
+    std::swap(snakeSerial, other.snakeSerial);
+    std::swap(worldLifetime, other.worldLifetime);
+    std::swap(worldLifetimeNew, other.worldLifetimeNew);
+    std::swap(worldDirection, other.worldDirection);
+    std::swap(worldClaim, other.worldClaim);
+    std::swap(nochanges, other.nochanges);
+    std::swap(snakeAction, other.snakeAction);
+    std::swap(snakeLength, other.snakeLength);
+    std::swap(directionSnake, other.directionSnake);
+    std::swap(positionSnakeHead, other.positionSnakeHead);
+    std::swap(positionFood, other.positionFood);
+    std::swap(universeMode, other.universeMode);
+    std::swap(packed, other.packed);
+    std::swap(snake, other.snake);
+    std::swap(bits, other.bits);
+    std::swap(bitsNew, other.bitsNew);
+    std::swap(seed, other.seed);
+    std::swap(generation, other.generation);
+    hashValid = false;
+    cyclePeriod = 0;
+}
 
-    worldDirection = new int[(Ny + 2) * (Nx + 2) + 1];
 
-    for (int i = 0; i <= (Ny + 2) * (Nx + 2); i++) {
-        // set border cells to -1 (still involving modular arithmetic -> toric case)
-        if ( (i < (Nx + 2)) || (i >= (Ny + 1) * (Nx + 2)) || (i % (Nx + 2) == 0) || (i % (Nx + 2) == (Nx + 1)) ) {
-            world[i] = -1;
-            worldNew[i] = -1;
+inline size_t CAbase::layoutBytes() {
+    /* bytes of all planes of the current mode and size */
 
-            worldColor[i] = -1;
-            worldColorNew[i] = -1;
+    size_t cells = (size_t) (Ny + 2) * (Nx + 2);
+    // Margolus blocks are rotated within the current plane, the snake only changes the cells at its ends
+    bool inPlace = (universeMode == 6) || snake;
+    size_t bytes = 0;
+    if (packed) {
+        bytes += 2 * Arena::planeBytes(BitPlane::storageWords(Nx, Ny), sizeof(uint64_t));
+    } else {
+        bytes += (inPlace ? 1 : 2) * Arena::planeBytes(cells, sizeof(int8_t));
+    }
+    if (snake) {
+        bytes += Arena::planeBytes(cells, sizeof(uint32_t));
+        bytes += Arena::planeBytes((size_t) Nx * Ny, sizeof(uint32_t));
+    }
+    if (universeMode == 2) {
+        bytes += 2 * Arena::planeBytes(cells, sizeof(int16_t));
+        bytes += 2 * Arena::planeBytes(cells, sizeof(int8_t));
+    }
+    return bytes;
+}
 
-            worldLifetime[i] = -1;
-            worldLifetimeNew[i] = -1;
 
-            worldDirection[i] = -1;
+inline void CAbase::takePlanes(bool filled) {
+    /* carve the planes of the current mode from the arena, always in the same order so that a
+     * snapshot of the arena is laid out the same way; filled: the arena already holds them */
+
+    size_t cells = (size_t) (Ny + 2) * (Nx + 2);
+    bool inPlace = (universeMode == 6) || snake;
+
+    world = worldNew = nullptr;
+    worldSlot = freeCells = nullptr;
+    worldLifetime = worldLifetimeNew = nullptr;
+    worldDirection = worldClaim = nullptr;
+
+    if (packed) {
+        // binary modes only need the two bit planes
+        uint64_t *b = arena.take<uint64_t>(BitPlane::storageWords(Nx, Ny));
+        uint64_t *bNew = arena.take<uint64_t>(BitPlane::storageWords(Nx, Ny));
+        if (filled) {
+            bits.adopt(Nx, Ny, b);
+            bitsNew.adopt(Nx, Ny, bNew);
+        } else {
+            bits.attach(Nx, Ny, b);
+            bitsNew.attach(Nx, Ny, bNew);
         }
-        else {
-            world[i] = 0;
-            worldNew[i] = 0;
+        return;
+    }
+    bits.attach(0, 0, nullptr);
+    bitsNew.attach(0, 0, nullptr);
+
+    world = arena.take<int8_t>(cells);
+    worldNew = inPlace ? nullptr : arena.take<int8_t>(cells);
+    if (snake) {
+        worldSlot = arena.take<uint32_t>(cells);
+        freeCells = arena.take<uint32_t>((size_t) Nx * Ny);
+    }
+    if (universeMode == 2) {
+        worldLifetime = arena.take<int16_t>(cells);
+        worldLifetimeNew = arena.take<int16_t>(cells);
+        worldDirection = arena.take<int8_t>(cells);
+        worldClaim = arena.take<int8_t>(cells);
+    }
+}
+
+
+inline bool CAbase::saveSnapshot(const char *path) {
+    /* write the universe as a snapshot: a header followed by the arena as it is in memory, which
+     * loadSnapshot maps instead of reading it. The file is written next to path and then renamed,
+     * so that a snapshot still mapped from path is never truncated */
+
+    SnapshotHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, "CASNAP\x1A\n", 8);
+    h.version = snapshotVersion;
+    h.byteOrder = snapshotByteOrder;
+    h.headerBytes = snapshotAlignment;
+    h.planeBytes = arena.getUsed();
+    h.universeMode = universeMode;
+    h.nx = Nx;
+    h.ny = Ny;
+    h.packed = packed;
+    h.borderMode = borderMode;
+    h.nochanges = nochanges;
+    h.snakeAction = snakeAction;
+    h.directionPast = directionSnake.past;
+    h.directionFuture = directionSnake.future;
+    h.snakeSerial = snakeSerial;
+    h.birth = rule.birth;
+    h.survival = rule.survival;
+    h.seed = seed;
+    h.generation = generation;
+    const uint8_t *base = arena.getBase();
+    h.world = world ? uint64_t(reinterpret_cast<const uint8_t *>(world) - base) : 0;
+    h.lifetime = worldLifetime ? uint64_t(reinterpret_cast<const uint8_t *>(worldLifetime) - base) : 0;
+    h.bits = packed ? uint64_t(reinterpret_cast<const uint8_t *>(bits.data()) - base) : 0;
+
+    std::string temporary = std::string(path) + ".part";
+    FILE *f = fopen(temporary.c_str(), "wb");
+    if (!f) return false;
+    std::vector<char> padding(h.headerBytes - sizeof(h), 0);
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1;
+    ok = ok && fwrite(padding.data(), 1, padding.size(), f) == padding.size();
+    ok = ok && fwrite(base, 1, arena.getUsed(), f) == arena.getUsed();
+    ok = (fclose(f) == 0) && ok;
+#ifdef _WIN32
+    // rename does not replace existing files
+    if (ok) remove(path);
+#endif
+    ok = ok && rename(temporary.c_str(), path) == 0;
+    if (!ok) remove(temporary.c_str());
+    return ok;
+}
+
+
+inline bool CAbase::loadSnapshot(const char *path, int mode) {
+    /* map a snapshot as the arena: its pages are read when they are first touched and copied when
+     * they are first written, the file is never changed. mode: the snapshot must hold a universe of
+     * this mode, any mode if -1. Every field of the header is checked against the size of the
+     * universe and of the file, and the cells of an unpacked universe against the mode, which reads
+     * its cell plane once; the universe is unchanged if the file is no valid snapshot */
+
+    SnapshotHeader h;
+    FILE *f = fopen(path, "rb");
+    if (!f) return false;
+    bool ok = fread(&h, sizeof(h), 1, f) == 1;
+    fclose(f);
+    if (!ok || memcmp(h.magic, "CASNAP\x1A\n", 8) != 0 || h.version != snapshotVersion ||
+        h.byteOrder != snapshotByteOrder || h.headerBytes != snapshotAlignment) return false;
+    if (h.universeMode < 0 || h.universeMode > 7 || (mode >= 0 && h.universeMode != mode)) return false;
+    if ((h.packed != 0 && h.packed != 1) || (h.packed && !isBinaryMode(h.universeMode))) return false;
+    int maxSize = h.packed ? maxPackedSize : maxIntSize;
+    // universes are square, the GUI relies on it
+    if (h.nx < 1 || h.nx != h.ny || h.nx > maxSize) return false;
+    if (h.borderMode != BorderTorus && h.borderMode != BorderWall) return false;
+    if (h.birth >= (1 << 9) || h.survival >= (1 << 9)) return false;
+
+    // a universe of its own, which hands its planes over once they are checked
+    CAbase next(1, 1);
+    next.universeMode = h.universeMode;
+    next.Nx = h.nx;
+    next.Ny = h.ny;
+    next.packed = (h.packed != 0);
+    next.snake = (h.universeMode == 1);
+    // the layout must be the one takePlanes carves, and the file must hold all of it
+    if (next.layoutBytes() != h.planeBytes) return false;
+    if (!next.arena.map(path, h.headerBytes, h.planeBytes)) return false;
+    next.takePlanes(true);
+
+    // the current planes may be the second of their pair
+    const uint8_t *base = next.arena.getBase();
+    auto offset = [base](const void *plane) {
+        return plane ? uint64_t(static_cast<const uint8_t *>(plane) - base) : uint64_t(0);
+    };
+    if (h.world != offset(next.world)) {
+        if (!next.worldNew || h.world != offset(next.worldNew)) return false;
+        std::swap(next.world, next.worldNew);
+    }
+    if (h.lifetime != offset(next.worldLifetime)) {
+        if (!next.worldLifetimeNew || h.lifetime != offset(next.worldLifetimeNew)) return false;
+        std::swap(next.worldLifetime, next.worldLifetimeNew);
+    }
+    if (h.bits != offset(next.bits.data())) {
+        if (!next.packed || h.bits != offset(next.bitsNew.data())) return false;
+        next.bits.swap(next.bitsNew);
+    }
+    // the cell kernels index tables with the values; packed bits cannot hold invalid ones
+    if (!next.packed) {
+        const int row = next.Nx + 2;
+        for (int y = 1; y <= next.Ny; y++) {
+            for (int x = 1; x <= next.Nx; x++) {
+                if (!isCellValue(next.universeMode, next.world[y * row + x])) return false;
+            }
+        }
+    }
+
+    next.nochanges = (h.nochanges != 0);
+    next.seed = h.seed;
+    next.generation = h.generation;
+    if (next.snake) {
+        next.snakeAction = h.snakeAction;
+        next.directionSnake.past = h.directionPast;
+        next.directionSnake.future = h.directionFuture;
+        next.snakeSerial = h.snakeSerial;
+        if (!next.rebuildSnake()) return false;
+    }
+
+    adoptUniverse(next);
+    borderMode = h.borderMode;
+    rule.birth = h.birth;
+    rule.survival = h.survival;
+    return true;
+}
+
+
+inline void CAbase::fillHalo() {
+    /* halo exchange for the stencil modes: write the border cells once per generation so that the
+     * cell kernels can read all neighbours without wrapping coordinates */
+
+    if (packed) {
+        bits.fillHalo(borderMode == BorderTorus);
+    } else {
+        fillHalo(world);
+    }
+}
+
+
+template <class T>
+inline void CAbase::fillHalo(T *plane) {
+    /* fill the border of a cell plane; the wall keeps dead cells outside the universe */
+
+    const int row = Nx + 2;
+    if (borderMode == BorderTorus) {
+        for (int iy = 1; iy <= Ny; iy++) {
+            plane[iy * row] = plane[iy * row + Nx];
+            plane[iy * row + Nx + 1] = plane[iy * row + 1];
+        }
+        for (int ix = 0; ix <= Nx + 1; ix++) {
+            plane[ix] = plane[Ny * row + ix];
+            plane[(Ny + 1) * row + ix] = plane[row + ix];
+        }
+    } else {
+        for (int iy = 1; iy <= Ny; iy++) {
+            plane[iy * row] = 0;
+            plane[iy * row + Nx + 1] = 0;
+        }
+        for (int ix = 0; ix <= Nx + 1; ix++) {
+            plane[ix] = 0;
+            plane[(Ny + 1) * row + ix] = 0;
+        }
+    }
+}
+
+
+template <class F>
+inline void CAbase::sweep(F cellEvolution) {
+    /* visit every interior cell in storage order: row by row within column tiles of tileWidth cells,
+     * so that the three rows a stencil touches stay in cache even for very wide universes */
+
+    sweepRows(1, Ny, cellEvolution);
+}
+
+
+template <class F>
+inline void CAbase::sweepRows(int y0, int y1, F cellEvolution) {
+    /* sweep restricted to the rows y0 .. y1 */
+
+    for (int x0 = 1; x0 <= Nx; x0 += tileWidth) {
+        int x1 = (x0 + tileWidth - 1 < Nx) ? x0 + tileWidth - 1 : Nx;
+        for (int iy = y0; iy <= y1; iy++) {
+            for (int ix = x0; ix <= x1; ix++) {
+                cellEvolution(ix, iy);
+            }
+        }
+    }
+}
+
+
+template <class F>
+inline uint64_t CAbase::reduceBands(F band) {
+    /* split the interior rows into one band per thread, call band(y0, y1) for each and OR the results
+     *
+     * Bands read the rows next to them straight from the current plane, whose halo is filled before,
+     * and write only their own rows of the new plane, so the result does not depend on the number of
+     * threads. */
+
+    return reduceBands(1, Ny, band);
+}
+
+
+template <class F>
+inline uint64_t CAbase::reduceBands(int y0, int y1, F band) {
+    /* the same for the rows y0 .. y1 of some other partition, e.g. rows of Margolus blocks */
+
+    if (y1 < y0) return 0;
+    if (getThreadCount() == 1) return band(y0, y1);
+
+    // one cache line per band, so that the results do not share lines
+    std::vector<uint64_t> results(8 * getThreadCount(), 0);
+    pool->parallelFor(y0, y1 + 1, [&](int b0, int b1, int b) {
+        results[8 * b] = band(b0, b1 - 1);
+    });
+    uint64_t r = 0;
+    for (size_t b = 0; b < results.size(); b += 8) r |= results[b];
+    return r;
+}
+
+
+template <class F>
+inline bool CAbase::sweepParallel(F cellEvolution) {
+    /* sweep over row bands on the thread pool; returns whether any cellEvolution call returned true */
+
+    return reduceBands([&](int y0, int y1) {
+        uint64_t changed = 0;
+        sweepRows(y0, y1, [&](int ix, int iy) {
+            changed |= cellEvolution(ix, iy);
+        });
+        return changed;
+    }) != 0;
+}
+
+
+template <class F>
+inline bool CAbase::sweepHashed(F cellEvolution) {
+    /* sweepParallel for the binary modes that also rehashes the rows that changed */
+
+    std::atomic<uint64_t> delta(0);
+    bool changed = reduceBands([&](int y0, int y1) {
+        uint64_t c = 0;
+        sweepRows(y0, y1, [&](int ix, int iy) {
+            c |= cellEvolution(ix, iy);
+        });
+        if (c && hashValid) {
+            uint64_t d = 0;
+            for (int iy = y0; iy <= y1; iy++) {
+                if (memcmp(&world[iy * (Nx + 2) + 1], &worldNew[iy * (Nx + 2) + 1], Nx) != 0) d ^= rehashRow(iy);
+            }
+            delta.fetch_xor(d, std::memory_order_relaxed);
+        }
+        return c;
+    }) != 0;
+    worldHash ^= delta.load();
+    return changed;
+}
+
+
+// CYCLE DETECTION
+inline uint64_t CAbase::hashRow(int iy, bool next) {
+    /* Zobrist hash of row iy of the current generation, or of the new one with next */
+
+    uint64_t h = 0;
+    if (packed) {
+        const uint64_t *r = next ? bitsNew.row(iy) : bits.row(iy);
+        int words = bits.getWords();
+        uint64_t index = (uint64_t) iy * words;
+        for (int i = 0; i < words - 1; i++) h ^= zobristWord(index + i, r[i]);
+        // the last word may also hold the right halo cell
+        h ^= zobristWord(index + words - 1, r[words - 1] & bits.lastWordMask());
+    } else {
+        // eight cells of 0 or 1 per word
+        const int8_t *r = (next ? worldNew : world) + iy * (Nx + 2) + 1;
+        uint64_t index = (uint64_t) iy * (Nx + 2);
+        int ix = 0;
+        for (; ix + 8 <= Nx; ix += 8) {
+            uint64_t w;
+            memcpy(&w, r + ix, 8);
+            h ^= zobristWord(index + ix, w);
+        }
+        if (ix < Nx) {
+            uint64_t w = 0;
+            memcpy(&w, r + ix, Nx - ix);
+            h ^= zobristWord(index + ix, w);
+        }
+    }
+    return h;
+}
+
+
+inline uint64_t CAbase::rehashRow(int iy) {
+    /* hash row iy of the new generation and return how the world hash changes */
+
+    uint64_t h = hashRow(iy, true);
+    uint64_t d = rowHash[iy] ^ h;
+    rowHash[iy] = h;
+    return d;
+}
+
+
+inline uint64_t CAbase::hashWorld() {
+    /* Zobrist hash of the current generation from scratch, which also resets the hashes of the rows */
+
+    rowHash.assign(Ny + 2, 0);
+    uint64_t h = 0;
+    for (int iy = 1; iy <= Ny; iy++) {
+        rowHash[iy] = hashRow(iy, false);
+        h ^= rowHash[iy];
+    }
+    return h;
+}
+
+
+inline void CAbase::resetCycle() {
+    /* start a new history with the current generation, after the universe was changed from outside */
+
+    hashHistory.assign(cycleHistoryLength, 0);
+    hashFilter.assign(4 * cycleHistoryLength, 0);
+    worldHash = hashWorld();
+    hashValid = true;
+    hashCount = 0;
+    cyclePeriod = 0;
+    cycleStart = 0;
+    trackCycle();
+}
+
+
+inline void CAbase::trackCycle() {
+    /* look the current generation up among the last cycleHistoryLength ones and add it to them
+     *
+     * The first match is the start of the cycle: one generation earlier the universe was not yet
+     * periodic, or the previous generation would have matched. Two different generations share a
+     * hash with a probability of about 2^-64 per pair. */
+
+    const uint64_t filterMask = 4 * cycleHistoryLength - 1;
+    uint64_t n = (hashCount < uint64_t(cycleHistoryLength)) ? hashCount : uint64_t(cycleHistoryLength);
+
+    // the history is only searched if some hash in it shares the lowest bits
+    if (cyclePeriod == 0 && hashFilter[worldHash & filterMask] > 0) {
+        for (uint64_t p = 1; p <= n; p++) {
+            if (hashHistory[(generation - p) & (cycleHistoryLength - 1)] == worldHash) {
+                cyclePeriod = p;
+                cycleStart = generation - p;
+                break;
+            }
+        }
+    }
+
+    uint64_t &slot = hashHistory[generation & (cycleHistoryLength - 1)];
+    if (n == uint64_t(cycleHistoryLength)) hashFilter[slot & filterMask]--;
+    slot = worldHash;
+    hashFilter[slot & filterMask]++;
+    hashCount++;
+}
+
+
+class CAview {
+    /* read-only view of the current generation: dimensions, snake state and the planes of the active
+     * mode. Taking a view copies no cells; it stays valid until the automaton is evolved or reset. */
+
+public:
+    CAview() :
+        Nx(0),
+        Ny(0),
+        universeMode(0),
+        world(nullptr),
+        worldSlot(nullptr),
+        snakeSerial(0),
+        worldLifetime(nullptr),
+        worldDirection(nullptr),
+        bits(nullptr),
+        snakeLength(0),
+        snakeAction(0)
+        {}
+
+    int getNx() const {
+        return Nx;
+    }
+
+    int getNy() const {
+        return Ny;
+    }
+
+    int getUniverseMode() const {
+        return universeMode;
+    }
+
+    int getValue(int x, int y) const {
+        if (bits) return bits->get(x, y);
+        int8_t v = world[y * (Nx + 2) + x];
+        // snake body segments count from the head
+        if (worldSlot && v == 10) return 10 + int(snakeSerial - worldSlot[y * (Nx + 2) + x]);
+        return v;
+    }
 
-            worldColor[i] = 0;
-            worldColorNew[i] = 0;
+    void renderRow(int y, int x0, int n, uint8_t *out) const {
+        /* one byte per cell x0 .. x0 + n - 1 of row y into out[0 .. n - 1], for an indexed image
+         *
+         * The bytes are the raw cell values (snake body segments all read 10), so a palette indexed
+         * by value colors the universe without any per-cell branching.
+         */
 
-            worldLifetime[i] = maxLifetime;
-            worldLifetimeNew[i] = maxLifetime;
+        if (!bits) {
+            memcpy(out, &world[y * (Nx + 2) + x0], n);
+            return;
+        }
+        // single cells up to the next byte of the bit plane (cell x sits at bit x - 1 of the row)
+        int i = 0;
+        for (; i < n && ((x0 + i - 1) & 7); i++) out[i] = bits->get(x0 + i, y);
+        // then eight bits at a time into eight bytes (little-endian): byte k of the product holds
+        // bit k, adding 0x7F moves any set bit to the top of its byte without a carry
+        const uint8_t *src = reinterpret_cast<const uint8_t *>(bits->row(y));
+        for (; i + 8 <= n; i += 8) {
+            uint64_t spread = (src[(x0 + i - 1) >> 3] * 0x0101010101010101ULL) & 0x8040201008040201ULL;
+            uint64_t bytes = ((spread + 0x7F7F7F7F7F7F7F7FULL) >> 7) & 0x0101010101010101ULL;
+            memcpy(out + i, &bytes, 8);
+        }
+        for (; i < n; i++) out[i] = bits->get(x0 + i, y);
+    }
+
+    void packRow(int y, uint64_t *out) const {
+        /* interior cells of row y as a bit row, cell x at bit x - 1, into (Nx + 63) / 64 words
+         * (binary modes only) */
 
-            worldDirection[i] = 0;
+        if (bits) {
+            // the bits past Nx belong to the border
+            memcpy(out, bits->row(y), bits->getWords() * sizeof(uint64_t));
+            out[bits->getWords() - 1] &= bits->lastWordMask();
+            return;
+        }
+        const int8_t *r = &world[y * (Nx + 2)];
+        memset(out, 0, (Nx + 63) / 64 * sizeof(uint64_t));
+        for (int x = 1; x <= Nx; x++) out[(x - 1) >> 6] |= uint64_t(r[x] != 0) << ((x - 1) & 63);
+    }
+
+    void countRow(int y, int x0, int x1, int columns, uint32_t *count) const {
+        /* add the occupied cells x0 .. x1 of row y to count[c], where column c covers the cells
+         * x0 + c * n / columns .. x0 + (c + 1) * n / columns - 1 of the n = x1 - x0 + 1 cells
+         * (columns <= n) */
+
+        const int8_t *r = bits ? nullptr : &world[y * (Nx + 2)];
+        int n = x1 - x0 + 1;
+        for (int c = 0; c < columns; c++) {
+            int c0 = x0 + int((int64_t) c * n / columns);
+            int c1 = x0 + int((int64_t) (c + 1) * n / columns) - 1;
+            if (bits) {
+                count[c] += bits->count(y, c0, c1);
+            } else {
+                uint32_t k = 0;
+                for (int x = c0; x <= c1; x++) k += (r[x] != 0);
+                count[c] += k;
+            }
         }
     }
+
+    int getLifetime(int x, int y) const {
+        // predator-prey only
+        return worldLifetime[y * (Nx + 2) + x];
+    }
+
+    int getDirection(int x, int y) const {
+        // predator-prey only
+        return worldDirection[y * (Nx + 2) + x];
+    }
+
+    int getSnakeLength() const {
+        return snakeLength;
+    }
+
+    int getSnakeAction() const {
+        return snakeAction;
+    }
+
+    CAbase::direction directionSnake;
+    CAbase::position positionSnakeHead, positionFood;
+
+private:
+    friend class CAbase;
+
+    int Nx;
+    int Ny;
+    int universeMode;
+    const int8_t *world;
+    const uint32_t *worldSlot;
+    uint32_t snakeSerial;
+    const int16_t *worldLifetime;
+    const int8_t *worldDirection;
+    const BitPlane *bits;
+    int snakeLength;
+    int snakeAction;
+};
+
+
+inline CAview CAbase::view() const {
+    /* zero-copy read-only view of the current generation */
+
+    CAview v;
+    v.Nx = Nx;
+    v.Ny = Ny;
+    v.universeMode = universeMode;
+    v.world = world;
+    v.worldSlot = worldSlot;
+    v.snakeSerial = snakeSerial;
+    v.worldLifetime = worldLifetime;
+    v.worldDirection = worldDirection;
+    v.bits = packed ? &bits : nullptr;
+    v.snakeLength = snakeLength;
+    v.snakeAction = snakeAction;
+    v.directionSnake = directionSnake;
+    v.positionSnakeHead = positionSnakeHead;
+    v.positionFood = positionFood;
+    return v;
 }
 
 
@@ -259,52 +1263,34 @@ inline int CAbase::cellEvolutionLife(int x, int y) {
      * Any dead cell with exactly three living neighbours becomes alive, as if by reproduction.
      */
 
-    int n_sum = 0;
-    int x1(0), y1(0);
-
-    for (int ix = -1; ix <= 1; ix++) {
-        for (int iy = -1; iy <= 1; iy++) {
-            if (ix == 0 && iy == 0) continue;
-            x1 = x + ix;
-            y1 = y + iy;
-
-            if (x1 < 1) x1 = Nx;
-            if (x1 > Nx) x1 = 1;
-            if (y1 < 1) y1 = Ny;
-            if (y1 > Ny) y1 = 1;
-            if (getValue(x1, y1) == 1) n_sum++;
-        }
-    }
+    // neighbours are read straight from the halo filled by fillHalo()
+    const int row = Nx + 2;
+    const int8_t *c = &world[y * row + x];
+    int n_sum = c[-row - 1] + c[-row] + c[-row + 1] +
+                c[-1]                 + c[1] +
+                c[row - 1]  + c[row]  + c[row + 1];
 
-    if (getValue(x, y) == 1) {
-        if (n_sum == 2 || n_sum == 3) setValueNew(x, y, 1);
-        else setValueNew(x, y, 0);
-    }
-    else {
-        if (n_sum == 3) setValueNew(x, y, 1);
-    }
+    worldNew[y * row + x] = ruleCell(makeRule(RULE_LIFE), c[0], n_sum);
     return 0;
 }
 
 
 inline void CAbase::worldEvolutionLife() {
     /* apply cell evolution to the universe */
-    for (int ix = 1; ix <= Nx; ix++) {
-        for (int iy = 1; iy <= Ny; iy++) {
-            cellEvolutionLife(ix, iy);
-        }
+    if (packed) {
+        worldEvolutionBits(lifeKernel().row);
+        return;
     }
 
-    nochanges = true;
-    /* copy new states to current states */
-    for (int ix = 1; ix <= Nx; ix++) {
-        for (int iy = 1; iy <= Ny; iy++) {
-            if (world[iy * (Nx + 2) + ix] != worldNew[iy * (Nx + 2) + ix]) {
-                nochanges = false;
-            }
-            world[iy * (Nx + 2) + ix] = worldNew[iy * (Nx + 2) + ix];
-        }
-    }
+    fillHalo();
+    bool changed = sweepHashed([&](int ix, int iy) {
+        cellEvolutionLife(ix, iy);
+        return worldNew[iy * (Nx + 2) + ix] != world[iy * (Nx + 2) + ix];
+    });
+
+    /* new states become current states */
+    swapBuffers();
+    nochanges = !changed;
 }
 
 
@@ -338,23 +1324,63 @@ inline CAbase::position CAbase::convert(int x, int y, int sD) {
 
 
 inline void CAbase::putNewFood() {
-    /* randomly put one piece of food on the field */
-
-    srand(time(NULL));
-    bool locationFound = false;
-    int xFood, yFood;
-
-    /* only put food in empty spots */
-    while (!locationFound) {
-        xFood = rand() % Nx + 1;
-        yFood = rand() % Ny + 1;
-        int v = getValue(xFood, yFood);
-        if (v != 0) continue;
-        locationFound = true;
-    }
-    positionFood.x = xFood;
-    positionFood.y = yFood;
-    setValue(xFood, yFood, 5);
+    /* randomly put one piece of food on an empty cell */
+
+    // nothing left to eat once the snake fills the universe
+    if (freeCount == 0) return;
+
+    uint32_t i = freeCells[philoxBelow(cellRandom(0, 0, RandomFood), int(freeCount))];
+    positionFood.x = i % (Nx + 2);
+    positionFood.y = i / (Nx + 2);
+    setValue(positionFood.x, positionFood.y, 5);
+}
+
+
+inline void CAbase::freeCellAdd(uint32_t i) {
+    worldSlot[i] = uint32_t(freeCount);
+    freeCells[freeCount++] = i;
+}
+
+
+inline void CAbase::freeCellRemove(uint32_t i) {
+    // the last empty cell takes the place of the removed one
+    uint32_t last = freeCells[--freeCount];
+    freeCells[worldSlot[i]] = last;
+    worldSlot[last] = worldSlot[i];
+}
+
+
+inline void CAbase::snakeRingReserve(size_t n) {
+    /* make room for the n most recent body segments, keeping those stored so far */
+
+    if (snakeRing.size() >= n) return;
+    size_t size = snakeRing.empty() ? 16 : snakeRing.size();
+    while (size < n) size *= 2;
+
+    std::vector<uint32_t> ring(size);
+    for (size_t k = 0; k < snakeRing.size(); k++) {
+        uint32_t serial = snakeSerial - uint32_t(k);
+        ring[serial & (size - 1)] = snakeRing[serial & (snakeRing.size() - 1)];
+    }
+    snakeRing.swap(ring);
+}
+
+
+inline void CAbase::setSnakeValue(size_t i, int v) {
+    /* set cell i of the snake universe to v (0 empty, 5 food, 10 + k body segment k), keeping the
+     * set of empty cells and the ring of body segments up to date */
+
+    if (world[i] == 0 && v != 0) freeCellRemove(uint32_t(i));
+    else if (world[i] != 0 && v == 0) freeCellAdd(uint32_t(i));
+
+    if (v >= 10) {
+        uint32_t serial = snakeSerial - uint32_t(v - 10);
+        snakeRingReserve(size_t(v - 10) + 1);
+        snakeRing[serial & (snakeRing.size() - 1)] = uint32_t(i);
+        worldSlot[i] = serial;
+        v = 10;
+    }
+    world[i] = v;
 }
 
 
@@ -381,6 +1407,65 @@ inline void CAbase::putInitSnake(){
 }
 
 
+inline bool CAbase::rebuildSnake() {
+    /* rebuild the ring of body segments, the length, head, food and the empty cells of a snake universe
+     * from its cells, after they were set from a file; false if the body segments 0 .. length - 1 do not
+     * form one path from the head to the tail, or any cell or the state of the snake is invalid */
+
+    const int row = Nx + 2;
+    const size_t cells = (size_t) Nx * Ny;
+    const uint32_t none = UINT32_MAX;
+    std::vector<uint32_t> segment(cells, none); // cell of body segment k
+    size_t length = 0;
+    int food = 0;
+
+    for (int y = 1; y <= Ny; y++) {
+        for (int x = 1; x <= Nx; x++) {
+            uint32_t i = uint32_t(y * row + x);
+            if (world[i] == 5) {
+                food++;
+                positionFood.x = x;
+                positionFood.y = y;
+            } else if (world[i] == 10) {
+                uint32_t k = snakeSerial - worldSlot[i];
+                if (k >= cells || segment[k] != none) return false;
+                segment[k] = i;
+                length++;
+            } else if (world[i] != 0) {
+                return false;
+            }
+        }
+    }
+    if (length == 0 || food > 1) return false;
+    for (size_t k = 1; k < length; k++) {
+        // consecutive segments are horizontal or vertical neighbours
+        if (segment[k] == none) return false;
+        uint32_t d = segment[k] > segment[k - 1] ? segment[k] - segment[k - 1] : segment[k - 1] - segment[k];
+        if (d != 1 && d != uint32_t(row)) return false;
+    }
+    for (int d : {directionSnake.past, directionSnake.future}) {
+        if (d != 2 && d != 4 && d != 6 && d != 8) return false;
+    }
+    if (snakeAction < 0 || snakeAction > 2) return false;
+
+    snakeLength = int(length);
+    positionSnakeHead.x = int(segment[0] % row);
+    positionSnakeHead.y = int(segment[0] / row);
+    snakeRing.clear();
+    snakeRingReserve(length);
+    for (size_t k = 0; k < length; k++) {
+        snakeRing[(snakeSerial - uint32_t(k)) & (snakeRing.size() - 1)] = segment[k];
+    }
+    freeCount = 0;
+    for (int y = 1; y <= Ny; y++) {
+        for (int x = 1; x <= Nx; x++) {
+            if (world[y * row + x] == 0) freeCellAdd(uint32_t(y * row + x));
+        }
+    }
+    return true;
+}
+
+
 inline void CAbase::calcSnakeAction(){
     /* calculate the next action of the snake (move / move and feed / die) */
 
@@ -399,11 +1484,11 @@ inline void CAbase::calcSnakeAction(){
         }
     }
 
-#ifndef QT_DEBUG
-    qDebug() << "positionSnakeHead: " << positionSnakeHead.x << " " << positionSnakeHead.y;
-    qDebug("Neighborhood of SnakeHead");
+#ifdef CA_SNAKE_TRACE
+    fprintf(stderr, "positionSnakeHead: %d %d\n", positionSnakeHead.x, positionSnakeHead.y);
+    fprintf(stderr, "Neighborhood of SnakeHead\n");
     for (int i = 0; i <= 2; i++) {
-        qDebug() << neighborhood[0][i] << " " <<  neighborhood[1][i] << " " << neighborhood[2][i];
+        fprintf(stderr, "%d %d %d\n", neighborhood[0][i], neighborhood[1][i], neighborhood[2][i]);
     }
 #endif
 
@@ -459,53 +1544,30 @@ inline void CAbase::worldEvolutionSnake() {
     calcSnakeAction();
     int dS = directionSnake.future;
 
-#ifndef QT_DEBUG
-    qDebug() << "action: " << snakeAction;
-    qDebug() << "future_dir: " << directionSnake.future << " " << "past_dir: " << directionSnake.past;
-    qDebug() << "slen: " << snakeLength;
+#ifdef CA_SNAKE_TRACE
+    fprintf(stderr, "action: %d\n", snakeAction);
+    fprintf(stderr, "future_dir: %d past_dir: %d\n", directionSnake.future, directionSnake.past);
+    fprintf(stderr, "slen: %d\n", snakeLength);
 #endif
 
-    // based on the global action each of the three cases is considered individually
+    // based on the global action each of the three cases is considered individually; only the cells at
+    // the ends of the snake change, so a step takes the same time for any universe and snake length
     switch (snakeAction) {
     //
     // move
     //
     case 0:
-        for (int x = 1; x <= Nx; x++) {
-            for (int y = 1; y <= Ny; y++) {
-                int v = getValue(x, y);
-                // head
-                if (v == 10) {
-#ifndef QT_DEBUG
-                    qDebug() << "(x, y) = (" << x << ", " << y << ")  -> (" << convert(x, y, dS).x << ", " << convert(x, y, dS).y << ")";
-#endif
-                    setValueNew(x, y, v + 1);
-                    setValueNew(convert(x, y, dS).x, convert(x, y, dS).y, 10);
-                    positionSnakeHead.x = convert(x, y, dS).x;
-                    positionSnakeHead.y = convert(x, y, dS).y;
-#ifndef QT_DEBUG
-                    qDebug() << "sH: " << positionSnakeHead.x << " " << positionSnakeHead.y;
+        // the tail cell becomes empty
+        setSnakeValue(snakeRing[(snakeSerial - uint32_t(snakeLength - 1)) & (snakeRing.size() - 1)], 0);
+
+        // new head
+        positionSnakeHead = convert(positionSnakeHead.x, positionSnakeHead.y, dS);
+        snakeSerial++;
+        setValue(positionSnakeHead.x, positionSnakeHead.y, 10);
+#ifdef CA_SNAKE_TRACE
+        fprintf(stderr, "sH: %d %d\n", positionSnakeHead.x, positionSnakeHead.y);
 #endif
-                // body
-                } else if (v > 10 && v < 10 + snakeLength - 1) {
-                    setValueNew(x, y, v + 1);
-                // tail
-                } else if (v == 10 + snakeLength - 1) {
-                    setValueNew(x, y, 0);
-                // food
-                } else if (v == 5) {
-                    setValueNew(x, y, v);
-                }
-                // otherwise values are initialized with 0
-            }
-        }
 
-        // copy new state to current universe
-        for (int x = 1; x <= Nx; x++) {
-            for (int y = 1; y <= Ny; y++) {
-                world[y * (Nx + 2) + x] = worldNew[y * (Nx + 2) + x];
-            }
-        }
         nochanges = false;
         directionSnake.past = directionSnake.future;
         break;
@@ -514,28 +1576,12 @@ inline void CAbase::worldEvolutionSnake() {
     // move and feed
     //
     case 1:
-        for (int x = 1; x <= Nx; x++) {
-            for (int y = 1; y <= Ny; y++) {
-                int v = getValue(x, y);
-                if (v == 10) {
-                    setValueNew(x, y, v + 1);
-                    setValueNew(convert(x, y, dS).x, convert(x, y, dS).y, 10);
-                    positionSnakeHead.x = convert(x, y, dS).x;
-                    positionSnakeHead.y = convert(x, y, dS).y;
-                } else if (v > 10) {
-                    setValueNew(x, y, v + 1);
-                } else {
-
-                }
-            }
-        }
+        // new head on the food cell, the tail stays
+        snakeRingReserve(snakeLength + 1);
+        positionSnakeHead = convert(positionSnakeHead.x, positionSnakeHead.y, dS);
+        snakeSerial++;
+        setValue(positionSnakeHead.x, positionSnakeHead.y, 10);
 
-        // copy new state to current universe
-        for (int x = 1; x <= Nx; x++) {
-            for (int y = 1; y <= Ny; y++) {
-                world[y * (Nx + 2) + x] = worldNew[y * (Nx + 2) + x];
-            }
-        }
         nochanges = false;
         snakeLength++;
         directionSnake.past = directionSnake.future;
@@ -556,76 +1602,34 @@ inline void CAbase::worldEvolutionSnake() {
 
 
 // PREDATOR
-inline void CAbase::cellEvolutionConsistency(int x, int y) {
-    /* rectify directions so that at most one neighbor is incoming */
-
-    int neighborhoodDirections[5] {0};
-    neighborhoodDirections[0] = getDirection(x, y);
-    neighborhoodDirections[1] = getDirection(x, y + 1); // down
-    neighborhoodDirections[2] = getDirection(x - 1, y); // left
-    neighborhoodDirections[3] = getDirection(x + 1, y); // right
-    neighborhoodDirections[4] = getDirection(x, y - 1); // up
-
-    int neighborhoodLifetimes[5] {0};
-    neighborhoodLifetimes[0] = getLifetime(x, y);
-    neighborhoodLifetimes[1] = getLifetime(x, y + 1); // down
-    neighborhoodLifetimes[2] = getLifetime(x - 1, y); // left
-    neighborhoodLifetimes[3] = getLifetime(x + 1, y); // right
-    neighborhoodLifetimes[4] = getLifetime(x, y - 1); // up
-
-    int incomingNeighbors[5] {0};
-    int incomingViableNeighbors[5] {0};
-    int n_sum = 0;
-    int nv_sum = 0;
+inline void CAbase::cellEvolutionClaim(int x, int y) {
+    /* resolve the claims on cell x, y: of the viable neighbors aiming at it, the one with the highest priority moves
+     *
+     * The priority only depends on seed, generation and the position of the neighbor, so the claims
+     * are independent of the order in which the cells are resolved. */
 
-    // compute incoming and "viable" incoming neighbors
+    int viable[4];
+    int nv_sum = 0;
     for (int i = 1; i < 5; i++) {
-        if (neighborhoodDirections[i] + 2 * i == 10) {
-            incomingNeighbors[i] = 1;
-            n_sum++;
-            if (neighborhoodLifetimes[i] > 0) { // a viable incoming neighbor must have a positive lifetime
-                incomingViableNeighbors[i] = 1;
-                nv_sum++;
-            }
+        CAbase::position neighbor = CAbase::convert(x, y, 2 * i);
+        // a viable incoming neighbor must have a positive lifetime
+        if (getDirection(neighbor.x, neighbor.y) + 2 * i == 10 && getLifetime(neighbor.x, neighbor.y) > 0) {
+            viable[nv_sum++] = i;
         }
     }
 
-    // no viable incoming neighbor -> all incoming neighbors won't move
-    if (nv_sum == 0) {
-        for (int i = 1; i < 5; i++) {
-            if (incomingNeighbors[i] == 1) {
-                CAbase::position incomingCellCoordinates = CAbase::convert(x, y, 2 * i);
-                setDirection(incomingCellCoordinates.x, incomingCellCoordinates.y, 0);
-            }
-        }
-    }
-    // exactly one viable incoming neighbor -> all other incoming neighbors won't move
-    else if (nv_sum == 1) {
-        for (int i = 1; i < 5; i++) {
-            if (incomingNeighbors[i] == 1 && incomingViableNeighbors[i] != 1) {
-                CAbase::position incomingCellCoordinates = CAbase::convert(x, y, 2 * i);
-                setDirection(incomingCellCoordinates.x, incomingCellCoordinates.y, 0);
-            }
-        }
-    }
-    // more than one viable incoming neighbor -> randomly pick one; all other incoming neighbors won't move
-    else {
-        int r = rand() % nv_sum + 1;
-        for (int i = 1; i < 5; i++) {
-            if (incomingNeighbors[i] == 1) {
-                CAbase::position incomingCellCoordinates = CAbase::convert(x, y, 2 * i);
-                if (incomingViableNeighbors[i] == 1) {
-                    r -= 1;
-                    if (r != 0) { // these incoming viable neighbors won't move
-                        setDirection(incomingCellCoordinates.x, incomingCellCoordinates.y, 0);
-                    }
-                }
-                else { // these incoming non-viable neighbors won't move
-                    setDirection(incomingCellCoordinates.x, incomingCellCoordinates.y, 0);
-                }
-            }
+    // priorities are only drawn if there is a conflict
+    int winner = (nv_sum > 0) ? viable[0] : 0;
+    uint64_t best = 0;
+    for (int k = 0; k < nv_sum && nv_sum > 1; k++) {
+        CAbase::position neighbor = CAbase::convert(x, y, 2 * viable[k]);
+        uint64_t priority = cellRandom(neighbor.x, neighbor.y, RandomClaim);
+        if (k == 0 || priority > best) {
+            winner = viable[k];
+            best = priority;
         }
     }
+    worldClaim[y * (Nx + 2) + x] = winner;
 }
 
 
@@ -635,24 +1639,16 @@ inline void CAbase::cellEvolutionMove(int x, int y) {
     int lifeTime = getLifetime(x, y);
     int value = getValue(x, y);
 
-    int neighborhoodDirections[5];
-    neighborhoodDirections[0] = getDirection(x, y);
-    neighborhoodDirections[1] = getDirection(x, y + 1); // down
-    neighborhoodDirections[2] = getDirection(x - 1, y); // left
-    neighborhoodDirections[3] = getDirection(x + 1, y); // right
-    neighborhoodDirections[4] = getDirection(x, y - 1); // up
-
-    int incomingNeighbors[5] {0};
-    int n_sum = 0;
-    for (int i = 0; i < 5; i++) {
-        if (neighborhoodDirections[i] + 2 * i == 10) {
-            incomingNeighbors[i] = 1;
-            n_sum++;
-        }
+    // a cell only leaves if it won the claim on its target
+    int direction = getDirection(x, y);
+    if (direction > 0) {
+        CAbase::position target = CAbase::convert(x, y, direction);
+        if (getClaim(target.x, target.y) != (10 - direction) / 2) direction = 0;
     }
+    int incoming = getClaim(x, y);
 
-    if (n_sum == 0) { // no neighbor aims at this cell
-        if (neighborhoodDirections[0] == 0) { // cell itself has no aim
+    if (incoming == 0) { // no neighbor moves to this cell
+        if (direction == 0) { // cell itself stays
             if (lifeTime == maxLifetime) { // non-living cell
                 setValueNew(x, y, getValue(x, y));
                 setLifetimeNew(x, y, maxLifetime);
@@ -667,26 +1663,19 @@ inline void CAbase::cellEvolutionMove(int x, int y) {
                 }
             }
 
-        } else { // cell itself aims at a legal position
+        } else { // cell itself moves away
             setValueNew(x, y, 0);
             setLifetimeNew(x, y, maxLifetime);
         }
 
-    } else if (n_sum == 1) { // exactly one living neighbor aims at this cell
-        int i = 1;
-        while (incomingNeighbors[i] != 1) {
-            i++;
-        }
-        position incomingCellCoordinates = convert(x, y, 2 * i);
+    } else { // exactly one living neighbor moves to this cell
+        position incomingCellCoordinates = convert(x, y, 2 * incoming);
         setValueNew(x, y, getValue(incomingCellCoordinates.x, incomingCellCoordinates.y));
         if (value == 2 || value == 5) { // cell is devoured
             setLifetimeNew(x, y, lifeTimeUI);
         } else {
             setLifetimeNew(x, y, getLifetime(incomingCellCoordinates.x, incomingCellCoordinates.y) - 1);
         }
-
-    } else if (n_sum > 1) {
-        qWarning() << "More than one neighbor aims at a cell!";
     }
 }
 
@@ -732,7 +1721,7 @@ inline void CAbase::cellEvolutionDirection(int x, int y) {
                 }
                 setDirection(x, y, 2 * i);
             } else if (na_sum > 1) { // more than one direction is allowed
-                int r = rand() % (na_sum) + 1;
+                int r = philoxBelow(cellRandom(x, y, RandomDirection), na_sum) + 1;
                 int i = 0;
                 while (r > 0) {
                     i += 1;
@@ -753,7 +1742,7 @@ inline void CAbase::cellEvolutionDirection(int x, int y) {
 
         // MOVE TOWARDS A RANDOM PREY NEIGHBOR
         } else if (n_sum > 1) {
-            int r = rand() % (n_sum) + 1;
+            int r = philoxBelow(cellRandom(x, y, RandomDirection), n_sum) + 1;
             int i = 0;
             while (r > 0) {
                 i += 1;
@@ -804,7 +1793,7 @@ inline void CAbase::cellEvolutionDirection(int x, int y) {
                     }
                     setDirection(x, y, 2 * i);
                 } else if (na_sum > 1) { // more than one direction is allowed
-                    int r = rand() % (na_sum) + 1;
+                    int r = philoxBelow(cellRandom(x, y, RandomDirection), na_sum) + 1;
                     int i = 0;
                     while (r > 0) {
                         i += 1;
@@ -823,7 +1812,7 @@ inline void CAbase::cellEvolutionDirection(int x, int y) {
                 setDirection(x, y, 2 * i);
             // MORE THAN ONE FOOD NEIGHBOR
             } else if (n_sum > 1) { // randomly move towards a random food neighbor
-                int r = rand() % (n_sum) + 1;
+                int r = philoxBelow(cellRandom(x, y, RandomDirection), n_sum) + 1;
                 int i = 0;
                 while (r > 0) {
                     i++;
@@ -845,63 +1834,45 @@ inline void CAbase::cellEvolutionDirection(int x, int y) {
 inline void CAbase::worldEvolutionPredator() {
     /* combine evolutionary functions on cell level to array level */
 
+    // each phase only reads what the previous one wrote, so all three run in parallel over row bands
+
     // calculate a priori possible moving directions for each cell
-    for (int ix = 1; ix <= Nx; ix++) {
-        for (int iy = 1; iy <= Ny; iy++) {
-            cellEvolutionDirection(ix, iy);
-        }
-    }
+    sweepParallel([&](int ix, int iy) {
+        cellEvolutionDirection(ix, iy);
+        return false;
+    });
 
-    // make sure there is at most one incoming viable neighbor for each cell
-    for (int ix = 1; ix <= Nx; ix++) {
-        for (int iy = 1; iy <= Ny; iy++) {
-            cellEvolutionConsistency(ix, iy);
-        }
-    }
+    // every cell picks the one viable neighbor that may move into it
+    sweepParallel([&](int ix, int iy) {
+        cellEvolutionClaim(ix, iy);
+        return false;
+    });
 
     // calculate new status and new lifetime for each cell
-    for (int ix = 1; ix <= Nx; ix++) {
-        for (int iy = 1; iy <= Ny; iy++) {
-            cellEvolutionMove(ix, iy);
-        }
-    }
-
-    nochanges = true;
-    for (int ix = 1; ix <= Nx; ix++) {
-        for (int iy = 1; iy <= Ny; iy++) {
-            // game goes on while at least one cell has lifetime >=0 and less than maxLifetime, so this cell isn't food or empty
-            if ((worldLifetimeNew[iy * (Nx + 2) + ix] >= 0) && (worldLifetimeNew[iy * (Nx + 2) + ix] < maxLifetime)) {
-                nochanges = false;
-            }
-            // transfer array values from new to current
-            world[iy * (Nx + 2) + ix] = worldNew[iy * (Nx + 2) + ix];
-            worldLifetime[iy * (Nx + 2) + ix] = worldLifetimeNew[iy * (Nx + 2) + ix];
-        }
-    }
+    bool alive = sweepParallel([&](int ix, int iy) {
+        cellEvolutionMove(ix, iy);
+        // game goes on while at least one cell has lifetime >=0 and less than maxLifetime, so this cell isn't food or empty
+        int16_t l = worldLifetimeNew[iy * (Nx + 2) + ix];
+        return l >= 0 && l < maxLifetime;
+    });
+    nochanges = !alive;
+
+    // new values and lifetimes become current
+    swapBuffers();
 }
 
 
 // NOISE
-inline CAbase::position CAbase::torifyPosition(CAbase::position inPos) {
-    /* */
-
-    CAbase::position outPos;
-    if (inPos.x == 0) outPos.x = Nx;
-    if (inPos.x == Nx + 1) outPos.x = 1;
-    if (inPos.y == 0) outPos.y = Ny;
-    if (inPos.y == Ny + 1) outPos.y = 1;
-    return outPos;
-}
-
-
 inline void CAbase::generateInitRandomNoise() {
     /* put some random noise on the field */
 
-    srand(time(NULL));
-    int randomDraws = rand() % (Nx * Ny + 1);
-    for (int i = 1; i <= randomDraws; i++) {
-        int xNoise = rand() % Nx + 1;
-        int yNoise = rand() % Ny + 1;
+    // up to 65536 x 65536 cells, more than an int counts
+    uint64_t randomDraws = philoxBelow64(cellRandom(0, 0, RandomNoise), (uint64_t) Nx * Ny + 1);
+    for (uint64_t i = 1; i <= randomDraws; i++) {
+        // draw i has its own counter (x, y), y = 1 for the first 2^31 draws
+        uint64_t r = cellRandom(int(i & 0x7FFFFFFF), int(i >> 31) + 1, RandomNoise);
+        int xNoise = philoxBelow(r, Nx) + 1;
+        int yNoise = philoxBelow(r << 32, Ny) + 1;
         setValue(xNoise, yNoise, 1);
     }
 }
@@ -910,40 +1881,31 @@ inline void CAbase::generateInitRandomNoise() {
 inline void CAbase::cellEvolutionNoise(int x, int y) {
     /* */
 
-    position down = torifyPosition(convert(x, y, 2));
-    position up = torifyPosition(convert(x, y, 8));
-    position left  = torifyPosition(convert(x, y, 4));
-    position right = torifyPosition(convert (x, y, 6));
+    const int row = Nx + 2;
+    const int8_t *c = &world[y * row + x];
 
-    int newNoise = (getValue(x, y) &
-                   getValue(up.x, up.y)) ^
-                   getValue(down.x, down.y) ^
-                   getValue(left.x, left.y) ^
-                   getValue(right.x, right.y) ^
-                   getValue(x, y);
+    int newNoise = (c[0] & c[-row]) ^ c[row] ^ c[-1] ^ c[1] ^ c[0];
 
-    setValueNew(x, y, newNoise);
+    worldNew[y * row + x] = newNoise;
 }
 
 
 inline void CAbase::worldEvolutionNoise() {
     /* apply cell evolution to the universe */
-    for (int ix = 1; ix <= Nx; ix++) {
-        for (int iy = 1; iy <= Ny; iy++) {
-            cellEvolutionNoise(ix, iy);
-        }
+    if (packed) {
+        worldEvolutionBits(bitRow<bitCellNoise>);
+        return;
     }
 
-    nochanges = true;
-    /* copy new states to current states */
-    for (int ix = 1; ix <= Nx; ix++) {
-        for (int iy = 1; iy <= Ny; iy++) {
-            if (world[iy * (Nx + 2) + ix] != worldNew[iy * (Nx + 2) + ix]) {
-                nochanges = false;
-            }
-            world[iy * (Nx + 2) + ix] = worldNew[iy * (Nx + 2) + ix];
-        }
-    }
+    fillHalo();
+    bool changed = sweepHashed([&](int ix, int iy) {
+        cellEvolutionNoise(ix, iy);
+        return worldNew[iy * (Nx + 2) + ix] != world[iy * (Nx + 2) + ix];
+    });
+
+    /* new states become current states */
+    swapBuffers();
+    nochanges = !changed;
 }
 
 
@@ -951,166 +1913,395 @@ inline void CAbase::worldEvolutionNoise() {
 inline void CAbase::cellEvolutionErosion(int x, int y) {
     /* */
 
-    position down = torifyPosition(convert(x, y, 2));
-    position up = torifyPosition(convert(x, y, 8));
-    position left  = torifyPosition(convert(x, y, 4));
-    position right = torifyPosition(convert (x, y, 6));
-    position downLeft = torifyPosition(convert(convert(x, y, 2).x, convert(x, y, 2).y, 4));
-    position downRight = torifyPosition(convert(convert(x, y, 2).x, convert(x, y, 2).y, 6));
-    position upLeft = torifyPosition(convert(convert(x, y, 8).x, convert(x, y, 8).y, 4));
-    position upRight = torifyPosition(convert(convert(x, y, 8).x, convert(x, y, 8).y, 6));
-
-    int newErosion = getValue(x, y) &
-                   (getValue(up.x, up.y) | getValue(upLeft.x, upLeft.y) | getValue(upRight.x, upRight.y)) &
-                   (getValue(right.x, right.y) | getValue(downRight.x, downRight.y) | getValue(upRight.x, upRight.y)) &
-                   (getValue(down.x, down.y) | getValue(downRight.x, downRight.y) | getValue(downLeft.x, downLeft.y)) &
-                   (getValue(left.x, left.y) | getValue(downLeft.x, downLeft.y) | getValue(upLeft.x, upLeft.y));
-    setValueNew(x, y, newErosion);
+    const int row = Nx + 2;
+    const int8_t *c = &world[y * row + x];
+    int up = c[-row], upLeft = c[-row - 1], upRight = c[-row + 1];
+    int down = c[row], downLeft = c[row - 1], downRight = c[row + 1];
+    int left = c[-1], right = c[1];
+
+    int newErosion = c[0] &
+                   (up | upLeft | upRight) &
+                   (right | downRight | upRight) &
+                   (down | downRight | downLeft) &
+                   (left | downLeft | upLeft);
+    worldNew[y * row + x] = newErosion;
 }
 
 
 inline void CAbase::worldEvolutionErosion() {
     /* apply cell evolution to the universe */
-
-    for (int ix = 1; ix <= Nx; ix++) {
-        for (int iy = 1; iy <= Ny; iy++) {
-            cellEvolutionErosion(ix, iy);
-        }
+    if (packed) {
+        worldEvolutionBits(bitRow<bitCellErosion>);
+        return;
     }
 
-    nochanges = true;
-    /* copy new states to current states */
-    for (int ix = 1; ix <= Nx; ix++) {
-        for (int iy = 1; iy <= Ny; iy++) {
-            if (world[iy * (Nx + 2) + ix] != worldNew[iy * (Nx + 2) + ix]) {
-                nochanges = false;
-            }
-            world[iy * (Nx + 2) + ix] = worldNew[iy * (Nx + 2) + ix];
-        }
-    }
+    fillHalo();
+    bool changed = sweepHashed([&](int ix, int iy) {
+        cellEvolutionErosion(ix, iy);
+        return worldNew[iy * (Nx + 2) + ix] != world[iy * (Nx + 2) + ix];
+    });
+
+    /* new states become current states */
+    swapBuffers();
+    nochanges = !changed;
 }
 
 
 // FLUIDS
 inline void CAbase::cellEvolutionFluids(int x, int y) {
-    /* */
-    int x1, y1;
-    int n_sum = 0;
-    for (int ix = -1; ix <= 1; ix++) {
-        for (int iy = -1; iy <= 1; iy++) {
-            if (ix == 0 && iy == 0) continue;
-            x1 = x + ix;
-            y1 = y + iy;
-
-            // torify
-            if (x1 < 1) x1 = Nx;
-            if (x1 > Nx) x1 = 1;
-            if (y1 < 1) y1 = Ny;
-            if (y1 > Ny) y1 = 1;
+    /* a cell is alive with exactly four or more than five living neighbours (B4678/S4678) */
 
-            if (getValue(x1, y1) == 1) n_sum++;
-        }
-    }
+    const int row = Nx + 2;
+    const int8_t *c = &world[y * row + x];
+    int n_sum = c[-row - 1] + c[-row] + c[-row + 1] +
+                c[-1]                 + c[1] +
+                c[row - 1]  + c[row]  + c[row + 1];
 
-    if (n_sum == 4 || n_sum > 5) {
-        setValueNew(x, y, 1);
-    } else setValueNew(x, y, 0);
+    worldNew[y * row + x] = ruleCell(makeRule(RULE_FLUIDS), c[0], n_sum);
 }
 
 
 inline void CAbase::worldEvolutionFluids() {
     /* apply cell evolution to the universe */
-
-    for (int ix = 1; ix <= Nx; ix++) {
-        for (int iy = 1; iy <= Ny; iy++) {
-            cellEvolutionFluids(ix, iy);
-        }
+    if (packed) {
+        worldEvolutionBits(fluidsKernel().row);
+        return;
     }
 
-    nochanges = true;
-    /* copy new states to current states */
-    for (int ix = 1; ix <= Nx; ix++) {
-        for (int iy = 1; iy <= Ny; iy++) {
-            if (world[iy * (Nx + 2) + ix] != worldNew[iy * (Nx + 2) + ix]) {
-                nochanges = false;
-            }
-            world[iy * (Nx + 2) + ix] = worldNew[iy * (Nx + 2) + ix];
-        }
-    }
+    fillHalo();
+    bool changed = sweepHashed([&](int ix, int iy) {
+        cellEvolutionFluids(ix, iy);
+        return worldNew[iy * (Nx + 2) + ix] != world[iy * (Nx + 2) + ix];
+    });
+
+    /* new states become current states */
+    swapBuffers();
+    nochanges = !changed;
 }
 
 
 // GASES
-inline void CAbase::cellEvolutionGases(int x, int y) {
-    /* rotate cells within each Margolus block */
+inline int gasesRotate(int block, bool ccw) {
+    /* rotate a Margolus block given as a | b << 1 | c << 2 | d << 3, with a b the top and c d the bottom cells */
+
+    static const uint8_t rotations[2][16] = {
+        {0, 2, 8, 10, 1, 3, 9, 11, 4, 6, 12, 14, 5, 7, 13, 15}, // clockwise: a <- c <- d <- b <- a
+        {0, 4, 1, 5, 8, 12, 9, 13, 2, 6, 3, 7, 10, 14, 11, 15}  // counter clockwise: a <- b <- d <- c <- a
+    };
+    return rotations[ccw][block];
+}
 
-    bool rotationDir = rand() % 2;
 
-    // make sure to identify boundaries in toric setting
-    int xTorus = x + 1;
-    int yTorus = y + 1;
+inline int CAbase::cellEvolutionGases(int x, int y, bool ccw) {
+    /* rotate the Margolus block with top left cell x, y in place; returns 1 if it ends the generation changed
+     *
+     * Bit 0 of a cell holds its current state. The first type of block (odd x) keeps the state the
+     * cell had at the start of the generation in bit 1, the second type (even x) compares against it
+     * and clears it, so changes are detected without a copy of the universe. */
+
+    // blocks of the second type wrap around the torus
+    const int row = Nx + 2;
+    int xRight = (x == Nx) ? 1 : x + 1;
+    int yDown = (y == Ny) ? 1 : y + 1;
+    int8_t *cell[4] = {&world[y * row + x], &world[y * row + xRight],
+                       &world[yDown * row + x], &world[yDown * row + xRight]};
+
+    int block = 0, initial = 0;
+    for (int k = 0; k < 4; k++) {
+        block |= (*cell[k] & 1) << k;
+        initial |= ((*cell[k] >> 1) & 1) << k;
+    }
+    int rotated = gasesRotate(block, ccw);
 
-    if (x == Nx) xTorus = 1;
-    if (y == Ny) yTorus = 1;
+    if (x % 2 == 1) {
+        for (int k = 0; k < 4; k++) {
+            *cell[k] = ((rotated >> k) & 1) | (((block >> k) & 1) << 1);
+        }
+        return 0;
+    }
+    for (int k = 0; k < 4; k++) {
+        *cell[k] = (rotated >> k) & 1;
+    }
+    return rotated != initial;
+}
 
-    if (rotationDir == 0) { // rotate clockwise
-        setValueNew(x, y, getValue(x, yTorus));
-        setValueNew(x, yTorus, getValue(xTorus, yTorus));
-        setValueNew(xTorus, yTorus, getValue(xTorus, y));
-        setValueNew(xTorus, y, getValue(x, y));
 
+inline void CAbase::settleCell(int x, int y, uint64_t &changed) {
+    /* clear the initial state of a cell that is not part of a block of the second type */
 
-    } else { // rotate counter clockwise
-        setValueNew(x, y, getValue(xTorus, y));
-        setValueNew(xTorus, y, getValue(xTorus, yTorus));
-        setValueNew(xTorus, yTorus, getValue(x, yTorus));
-        setValueNew(x, yTorus, getValue(x, y));
-    }
+    int8_t &v = world[y * (Nx + 2) + x];
+    changed |= (v & 1) != (v >> 1);
+    v &= 1;
 }
 
 
 inline void CAbase::worldEvolutionGases() {
-    /* apply cell evolution to the universe */
+    /* apply cell evolution to the universe: two phases of independent blocks, both rotated in place */
+    if (packed) {
+        worldEvolutionGasesBits();
+        return;
+    }
 
-    // save initial state for later comparison
-    int* worldInitial = new int[(Nx + 2) * (Ny + 2) + 1];
-    for (int ix = 1; ix <= Nx; ix++) {
-        for (int iy = 1; iy <= Ny; iy++) {
-            worldInitial[iy * (Nx + 2) + ix] = world[iy * (Nx + 2) + ix];
+    const int row = Nx + 2;
+    bool wrapX = (borderMode == BorderTorus) && (Nx % 2 == 0);
+    bool wrapY = (borderMode == BorderTorus) && (Ny % 2 == 0);
+
+    // rotate the blocks of one row of blocks, x0 .. xMax being the left cells; one random word per 32 blocks
+    auto rotateRow = [&](int y, int x0, int xMax) {
+        uint64_t changed = 0, r = 0;
+        for (int x = x0; x <= xMax; x += 2) {
+            if (((x - x0) & 63) == 0) r = cellRandom((x - x0) >> 6, y, RandomGases);
+            changed |= cellEvolutionGases(x, y, (r >> ((x - x0) & 63)) & 1);
         }
+        return changed;
+    };
+
+    // first type of Margolus neighborhood: blocks start at odd x and odd y
+    reduceBands(1, Ny / 2, [&](int b0, int b1) {
+        for (int b = b0; b <= b1; b++) rotateRow(2 * b - 1, 1, Nx - 1);
+        return uint64_t(0);
+    });
+    // with odd sizes the last column and row are not part of a block, their state is also the initial one
+    for (int iy = 1; iy <= Ny && Nx % 2 != 0; iy++) world[iy * row + Nx] = (world[iy * row + Nx] & 1) * 3;
+    for (int ix = 1; ix <= Nx && Ny % 2 != 0; ix++) world[Ny * row + ix] = (world[Ny * row + ix] & 1) * 3;
+
+    // second type of Margolus neighborhood: blocks start at even x and even y and wrap around the torus
+    int xLeftMax = wrapX ? Nx : Nx - 1;
+    int yTopMax = wrapY ? Ny : Ny - 1;
+    uint64_t changed = reduceBands(1, yTopMax / 2, [&](int b0, int b1) {
+        uint64_t c = 0;
+        for (int b = b0; b <= b1; b++) c |= rotateRow(2 * b, 2, xLeftMax);
+        return c;
+    });
+
+    // the first column and row (and with a wall also the last ones) are only part of a block if they wrap around
+    auto edgeRow = [&](int iy) {
+        return !wrapY && (iy == 1 || (iy == Ny && Ny % 2 == 0));
+    };
+    for (int ix = 1; ix <= Nx; ix++) {
+        if (edgeRow(1)) settleCell(ix, 1, changed);
+        if (edgeRow(Ny) && Ny > 1) settleCell(ix, Ny, changed);
     }
+    for (int iy = 1; iy <= Ny && !wrapX; iy++) {
+        if (edgeRow(iy)) continue;
+        settleCell(1, iy, changed);
+        if (Nx % 2 == 0) settleCell(Nx, iy, changed);
+    }
+    nochanges = (changed == 0);
+}
 
-    // first type of Margolus neighborhood
-    for (int ix = 1; ix <= int(Nx / 2); ix++) {
-        for (int iy = 1; iy <= int(Ny / 2); iy++) {
-            cellEvolutionGases(2 * ix - 1, 2 * iy - 1);
-        }
+
+// EVOLUTION
+inline void CAbase::worldEvolution() {
+    /* evolve the universe of the current mode by one generation */
+
+    // the deterministic modes keep a hash of every generation to find cycles
+    bool cycles = cycleDetection && isCycleMode(universeMode);
+    if (cycles && !hashValid) resetCycle();
+
+    switch (universeMode) {
+    case 0: worldEvolutionLife(); break;
+    case 1: worldEvolutionSnake(); break;
+    case 2: worldEvolutionPredator(); break;
+    case 3: worldEvolutionNoise(); break;
+    case 4: worldEvolutionErosion(); break;
+    case 5: worldEvolutionFluids(); break;
+    case 6: worldEvolutionGases(); break;
+    case 7: worldEvolutionRule(); break;
+    default: break;
     }
-    // copy back
-    for (int ix = 1; ix <= Nx; ix++) {
-        for (int iy = 1; iy <= Ny; iy++) {
-            world[iy * (Nx + 2) + ix] = worldNew[iy * (Nx + 2) + ix];
+    // random numbers are keyed on the generation
+    generation++;
+    if (cycles) trackCycle();
+}
+
+
+inline uint64_t CAbase::evolveGenerations(uint64_t n) {
+    /* evolve n generations as fast as possible; returns the generations actually evolved, fewer if the
+     * universe came to a halt
+     *
+     * Whole periods are only skipped once trackCycle has found the Zobrist hash of the current
+     * generation among the last cycleHistoryLength (1024) ones, so only periods up to 1024 are ever
+     * skipped. The match compares hashes, not cells: the skip assumes that equal hashes mean equal
+     * universes, which two different generations violate with a probability of about 2^-64. */
+
+    for (uint64_t g = 0; g < n; g++) {
+        worldEvolution();
+        if (nochanges) return g + 1;
+        if (cyclePeriod > 0) {
+            // the skipped generations are a multiple of the period, so the history stays valid
+            uint64_t rest = (n - g - 1) % cyclePeriod;
+            generation += (n - g - 1) - rest;
+            for (uint64_t r = 0; r < rest; r++) worldEvolution();
+            return n;
         }
     }
+    return n;
+}
+
+
+// CUSTOM RULE
+inline void CAbase::cellEvolutionRule(int x, int y) {
+    /* a dead cell is born and a living cell survives if its neighbour count is part of the rule */
+
+    const int row = Nx + 2;
+    const int8_t *c = &world[y * row + x];
+    int n_sum = c[-row - 1] + c[-row] + c[-row + 1] +
+                c[-1]                 + c[1] +
+                c[row - 1]  + c[row]  + c[row + 1];
+
+    worldNew[y * row + x] = ruleCell(rule, c[0], n_sum);
+}
+
 
-    // second type of Margolus neighborhood
-    for (int ix = 1; ix <= int(Nx / 2); ix++) {
-        for (int iy = 1; iy <= int(Ny / 2); iy++) {
-            cellEvolutionGases(2 * ix, 2 * iy);
+inline void CAbase::worldEvolutionRule() {
+    /* apply cell evolution to the universe */
+    if (packed) {
+        // well-known rules have a kernel compiled for them, any other rule passes its masks at runtime
+        const LifeKernel *preset = presetRuleKernel(rule);
+        if (preset) {
+            worldEvolutionBits(preset->row);
+        } else {
+            RuleRowFunction row = dynamicRuleKernel().row;
+            LifeRule r = rule;
+            worldEvolutionBits([row, r](const uint64_t *up, const uint64_t *mid, const uint64_t *down, uint64_t *out,
+                                        int words, uint64_t lastMask) {
+                return row(up, mid, down, out, words, lastMask, r);
+            });
         }
+        return;
     }
 
-    nochanges = true;
-    for (int ix = 1; ix <= Nx; ix++) {
-        for (int iy = 1; iy <= Ny; iy++) {
-            if (worldInitial[iy * (Nx + 2) + ix] != worldNew[iy * (Nx + 2) + ix]) {
-                nochanges = false;
+    fillHalo();
+    bool changed = sweepHashed([&](int ix, int iy) {
+        cellEvolutionRule(ix, iy);
+        return worldNew[iy * (Nx + 2) + ix] != world[iy * (Nx + 2) + ix];
+    });
+
+    /* new states become current states */
+    swapBuffers();
+    nochanges = !changed;
+}
+
+
+// BIT-PACKED EVOLUTION
+template <class R>
+inline void CAbase::worldEvolutionBits(R rowEvolution) {
+    /* apply a row kernel to every row of the bit-packed universe */
+
+    fillHalo();
+
+    int words = bits.getWords();
+    uint64_t lastMask = bits.lastWordMask();
+    std::atomic<uint64_t> delta(0);
+    uint64_t changed = reduceBands([&](int y0, int y1) {
+        uint64_t c = 0, d = 0;
+        for (int iy = y0; iy <= y1; iy++) {
+            if (!rowEvolution(bits.row(iy - 1), bits.row(iy), bits.row(iy + 1), bitsNew.row(iy), words, lastMask)) continue;
+            c = 1;
+            // only the rows that changed are rehashed
+            if (hashValid) d ^= rehashRow(iy);
+        }
+        delta.fetch_xor(d, std::memory_order_relaxed);
+        return c;
+    });
+    worldHash ^= delta.load();
+
+    swapBuffers();
+    nochanges = (changed == 0);
+}
+
+
+inline uint64_t lowBits(int n) {
+    /* mask of the n lowest bits, n clamped to 0 .. 64 */
+    if (n <= 0) return 0;
+    if (n >= 64) return ~uint64_t(0);
+    return (uint64_t(1) << n) - 1;
+}
+
+
+inline void CAbase::worldEvolutionGasesBits() {
+    /* Margolus rotations on the bit-packed universe, 32 blocks per word */
+
+    const uint64_t evenBits = 0x5555555555555555ULL;
+    int words = bits.getWords();
+    uint64_t lastMask = bits.lastWordMask();
+
+    // first type of Margolus neighborhood: blocks start at odd x and odd y, word aligned;
+    // every band of block rows runs on its own thread
+    reduceBands(1, (Ny + 1) / 2, [&](int b0, int b1) {
+        for (int iy = 2 * b0 - 1; iy <= 2 * b1 - 1; iy += 2) {
+            const uint64_t *top = bits.row(iy);
+            uint64_t *topNew = bitsNew.row(iy);
+            if (iy == Ny) { // odd height: last row is not part of a block
+                for (int i = 0; i < words; i++) topNew[i] = top[i];
+                break;
             }
-            // copy back
-            world[iy * (Nx + 2) + ix] = worldNew[iy * (Nx + 2) + ix];
+            const uint64_t *bottom = bits.row(iy + 1);
+            uint64_t *bottomNew = bitsNew.row(iy + 1);
+            for (int i = 0; i < words; i++) {
+                uint64_t t = top[i], b = bottom[i];
+                // the right cell of a block must still be an interior cell
+                bitRotateBlocks(t, b, evenBits & lowBits(Nx - 64 * i - 1), cellRandom(i, iy, RandomGases));
+                topNew[i] = t;
+                bottomNew[i] = b;
+            }
+        }
+        return uint64_t(0);
+    });
+    swapBuffers();
+    fillHalo();
+
+    // second type of Margolus neighborhood: blocks start at even x and even y and wrap around the torus;
+    // the new universe still holds the initial state, so changes are detected while the rows are written
+    bool wrapX = (borderMode == BorderTorus) && (Nx % 2 == 0);
+    bool wrapY = (borderMode == BorderTorus) && (Ny % 2 == 0);
+    int xLeftMax = wrapX ? Nx : Nx - 1;
+    int yTopMax = wrapY ? Ny : Ny - 1;
+
+    uint64_t changed = reduceBands(1, yTopMax / 2, [&](int b0, int b1) {
+        std::vector<uint64_t> top(words), bottom(words);
+        uint64_t c = 0;
+        for (int iy = 2 * b0; iy <= 2 * b1; iy += 2) {
+            const uint64_t *in[2] = {bits.row(iy), bits.row(iy + 1)};
+            uint64_t *out[2] = {bitsNew.row(iy), bitsNew.row(iy + 1 > Ny ? 1 : iy + 1)};
+
+            // shift both rows by one cell so that the blocks become word aligned (x = 2 at bit 0)
+            for (int i = 0; i < words; i++) {
+                top[i] = bitEast(in[0], i);
+                bottom[i] = bitEast(in[1], i);
+                bitRotateBlocks(top[i], bottom[i], evenBits & lowBits(xLeftMax - 1 - 64 * i), cellRandom(i, iy, RandomGases));
+            }
+
+            // shift back; cell x = 1 is either the wrapped right cell of the last block or unchanged
+            for (int r = 0; r < 2; r++) {
+                const uint64_t *shifted = (r == 0) ? top.data() : bottom.data();
+                uint64_t first = wrapX ? (shifted[(Nx - 1) >> 6] >> ((Nx - 1) & 63)) & 1 : in[r][0] & 1;
+                for (int i = 0; i < words; i++) {
+                    uint64_t next = (shifted[i] << 1) | (i == 0 ? first : shifted[i - 1] >> 63);
+                    uint64_t mask = (i == words - 1) ? lastMask : ~uint64_t(0);
+                    c |= (next ^ out[r][i]) & mask;
+                    out[r][i] = next & mask;
+                }
+            }
+        }
+        return c;
+    });
+
+    // rows that are not part of any block keep their state
+    auto keepRow = [&](int iy) {
+        for (int i = 0; i < words; i++) {
+            uint64_t mask = (i == words - 1) ? lastMask : ~uint64_t(0);
+            changed |= (bitsNew.row(iy)[i] ^ bits.row(iy)[i]) & mask;
+            bitsNew.row(iy)[i] = bits.row(iy)[i];
         }
+    };
+    if (!wrapY) {
+        keepRow(1);
+        if ((yTopMax / 2) * 2 + 1 < Ny) keepRow(Ny);
     }
-    delete[] worldInitial;
+    swapBuffers();
+    nochanges = (changed == 0);
 }
 
 
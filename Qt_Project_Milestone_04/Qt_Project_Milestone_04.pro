@@ -22,17 +22,38 @@ DEFINES += QT_DEPRECATED_WARNINGS
 # You can also select to disable deprecated APIs only up to a certain version of Qt.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
+# trace every step of the snake on stderr
+#DEFINES += CA_SNAKE_TRACE
+
+# the SIMD Life kernels only pass wide vectors between always inlined helpers
+gcc: QMAKE_CXXFLAGS += -Wno-psabi
 
 SOURCES += \
         main.cpp \
         mainwindow.cpp \
         gamewidget.cpp \
-        keypressfilter.cpp
+        keypressfilter.cpp \
+        gameio.cpp \
+        hashlife.cpp \
+        patternio.cpp \
+        simulation.cpp
 
 HEADERS += \
         mainwindow.h \
         gamewidget.h \
         CAbase.h \
+        arena.h \
+        gameio.h \
+        hashlife.h \
+        patternio.h \
+        simulation.h \
+        triplebuffer.h \
+        threadpool.h \
+        bitplane.h \
+        lifekernel.h \
+        philox.h \
+        rules.h \
+        zobrist.h \
         keypressfilter.h
 
 FORMS += \
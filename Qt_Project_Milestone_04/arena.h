@@ -0,0 +1,196 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+#include <utility>
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+class Arena {
+    /* one aligned memory block that all cell planes of a universe are carved from
+     *
+     * Planes are handed out back to back, each starting on its own cache line. Blocks of at least one
+     * huge page are aligned to 2 MiB and, on Linux, advised as transparent huge pages, which spares
+     * the page walks of large universes. The arena owns its block and can be moved but not copied.
+     *
+     * The block can also be a private mapping of a file (a snapshot), whose pages are only read
+     * when they are first touched and copied when they are first written.
+     */
+
+public:
+    static const size_t alignment = 64;
+    static const size_t hugePageSize = size_t(2) << 20;
+
+    Arena() :
+        base(nullptr),
+        capacity(0),
+        used(0),
+        hugePages(true),
+        mapped(false)
+        {}
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    Arena(Arena &&other) :
+        base(other.base),
+        capacity(other.capacity),
+        used(other.used),
+        hugePages(other.hugePages),
+        mapped(other.mapped)
+        { other.base = nullptr; other.capacity = 0; other.used = 0; other.mapped = false; }
+
+    Arena &operator=(Arena &&other) {
+        if (this != &other) {
+            release();
+            base = other.base;
+            capacity = other.capacity;
+            used = other.used;
+            // the huge page setting stays the one of this arena
+            mapped = other.mapped;
+            other.base = nullptr;
+            other.capacity = 0;
+            other.used = 0;
+            other.mapped = false;
+        }
+        return *this;
+    }
+
+    ~Arena() {
+        release();
+    }
+
+    static size_t planeBytes(size_t n, size_t elementSize) {
+        // bytes one plane of n elements occupies, padded to a full cache line
+        return (n * elementSize + alignment - 1) & ~(alignment - 1);
+    }
+
+    void reserve(size_t bytes) {
+        /* replace the block by a new one of at least the given size; throws std::bad_alloc */
+
+        release();
+        if (bytes == 0) return;
+
+        bool huge = hugePages && bytes >= hugePageSize;
+        size_t align = huge ? hugePageSize : alignment;
+        size_t size = (bytes + align - 1) & ~(align - 1);
+#ifdef _WIN32
+        void *p = _aligned_malloc(size, align);
+        if (!p) throw std::bad_alloc();
+#else
+        void *p = nullptr;
+        if (posix_memalign(&p, align, size) != 0) throw std::bad_alloc();
+#endif
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+        if (huge) madvise(p, size, MADV_HUGEPAGE);
+#endif
+        base = static_cast<uint8_t *>(p);
+        capacity = size;
+        used = 0;
+    }
+
+    bool map(const char *path, size_t offset, size_t bytes) {
+        /* use bytes of a file from offset (a multiple of the page size) as the block, copy-on-write;
+         * the file itself never changes. Returns false if it is too short or cannot be read */
+
+        release();
+        if (bytes == 0) return true;
+#ifdef _WIN32
+        // no mapping: the block is read in full
+        reserve(bytes);
+        FILE *f = fopen(path, "rb");
+        bool ok = f && _fseeki64(f, (__int64) offset, SEEK_SET) == 0 && fread(base, 1, bytes, f) == bytes;
+        if (f) fclose(f);
+        if (!ok) release();
+        return ok;
+#else
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        void *p = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && uint64_t(st.st_size) >= uint64_t(offset) + bytes) {
+            p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, off_t(offset));
+        }
+        // the mapping keeps the file alive
+        close(fd);
+        if (p == MAP_FAILED) return false;
+        base = static_cast<uint8_t *>(p);
+        capacity = bytes;
+        used = 0;
+        mapped = true;
+        return true;
+#endif
+    }
+
+    template <class T>
+    T *take(size_t n) {
+        // next plane of n elements; the caller reserved room for it
+        T *plane = reinterpret_cast<T *>(base + used);
+        used += planeBytes(n, sizeof(T));
+        return plane;
+    }
+
+    void release() {
+#ifdef _WIN32
+        _aligned_free(base);
+#else
+        if (mapped) munmap(base, capacity);
+        else free(base);
+#endif
+        mapped = false;
+        base = nullptr;
+        capacity = 0;
+        used = 0;
+    }
+
+    size_t getCapacity() const {
+        return capacity;
+    }
+
+    void swap(Arena &other) {
+        /* exchange the blocks, each arena keeps its huge page setting */
+
+        std::swap(base, other.base);
+        std::swap(capacity, other.capacity);
+        std::swap(used, other.used);
+        std::swap(mapped, other.mapped);
+    }
+
+    const uint8_t *getBase() const {
+        return base;
+    }
+
+    size_t getUsed() const {
+        // bytes handed out as planes
+        return used;
+    }
+
+    bool getHugePages() const {
+        return hugePages;
+    }
+
+    void setHugePages(bool h) {
+        // takes effect with the next reserve
+        hugePages = h;
+    }
+
+private:
+    uint8_t *base;
+    size_t capacity;
+    size_t used;
+    bool hugePages;
+    bool mapped;    // base is a file mapping, not an allocation
+};
+
+
+#endif // ARENA_H
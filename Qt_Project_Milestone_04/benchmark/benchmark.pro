@@ -0,0 +1,28 @@
+#-------------------------------------------------
+#
+# Benchmark suite for the cellular automata core (no Qt)
+#
+#-------------------------------------------------
+
+CONFIG   += console c++11 thread
+CONFIG   -= qt app_bundle
+
+TARGET = ca_benchmark
+TEMPLATE = app
+
+INCLUDEPATH += ..
+
+gcc: QMAKE_CXXFLAGS += -Wno-psabi
+
+SOURCES += \
+        main.cpp
+
+HEADERS += \
+        ../CAbase.h \
+        ../arena.h \
+        ../bitplane.h \
+        ../lifekernel.h \
+        ../philox.h \
+        ../rules.h \
+        ../threadpool.h \
+        ../zobrist.h
@@ -0,0 +1,294 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+
+#include "CAbase.h"
+
+/* Benchmark suite for the evolution of every universe mode
+ *
+ * Times worldEvolution for every mode, edge length, initial density and engine and reports the time
+ * per cell and generation, the cells per second, the bytes per cell the planes of the mode occupy
+ * and the peak resident set size of the run, as a table or as JSON for tracking regressions.
+ *
+ * Engines: "int" is the reference (int planes, tiled row-major sweep), "packed" the bit-packed
+ * planes of the binary modes, "column" the int planes visited column by column (tile width 1).
+ * Every run starts from the same seed; cycle detection is off, so only the evolution is timed.
+ * Snake has no density and steers around a rectangle so that it does not hit the border.
+ *
+ * usage: ca_benchmark [--json] [--modes life,snake,...] [--engines int,packed,column]
+ *                     [--densities 0.1,0.3,0.5] [--threads T] [edge length ...]
+ *
+ * Edge lengths default to 64, 256, 1024, 4096 and 16384; the largest int planes need a few GB.
+ */
+
+static const char *modeNames[] = {"life", "snake", "predator", "noise", "erosion", "fluids", "gases", "rule"};
+static const char *engineNames[] = {"int", "packed", "column"};
+
+enum engines {
+    EngineInt,
+    EnginePacked,
+    EngineColumn
+};
+
+
+struct Result {
+    int mode;
+    int engine;
+    int edge;
+    double density;     // negative if the mode has none
+    int generations;
+    double nsPerCell;
+    double bytesPerCell;
+    double peakRss;     // bytes, 0 if unknown
+    bool outOfMemory;
+};
+
+
+static void resetPeakRss() {
+    /* start a new peak of the resident set size (Linux only) */
+#ifdef __linux__
+    FILE *f = fopen("/proc/self/clear_refs", "w");
+    if (f) {
+        fputs("5", f);
+        fclose(f);
+    }
+#endif
+}
+
+
+static double peakRss() {
+    /* peak resident set size in bytes since the last resetPeakRss, or of the whole process */
+#ifdef __linux__
+    FILE *f = fopen("/proc/self/status", "r");
+    if (f) {
+        char line[256];
+        double kb = 0;
+        while (fgets(line, sizeof(line), f)) {
+            if (strncmp(line, "VmHWM:", 6) == 0) kb = atof(line + 6);
+        }
+        fclose(f);
+        if (kb > 0) return kb * 1024;
+    }
+#endif
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return double(usage.ru_maxrss);
+#else
+    return double(usage.ru_maxrss) * 1024;
+#endif
+}
+
+
+static void populate(CAbase &ca, int mode, int n, double density) {
+    /* random initial state for the given universe mode, drawn from the seed */
+
+    if (mode == 1) {
+        ca.putInitSnake();
+        ca.putNewFood();
+        return;
+    }
+    uint64_t threshold = uint64_t(density * 4294967296.0);
+    for (int y = 1; y <= n; y++) {
+        for (int x = 1; x <= n; x++) {
+            uint64_t r = ca.cellRandom(x, y, CAbase::RandomNoise);
+            if ((r >> 32) >= threshold) continue;
+            if (mode == 2) {
+                // occupied cells hold predators, prey and food at 1 : 2 : 1
+                int kind = philoxBelow(r << 32, 4);
+                if (kind == 3) {
+                    ca.setValue(x, y, 5);
+                } else {
+                    ca.setValue(x, y, kind == 0 ? 1 : 2);
+                    ca.setLifetime(x, y, ca.lifeTimeUI);
+                }
+            } else {
+                ca.setValue(x, y, 1);
+            }
+        }
+    }
+}
+
+
+static Result run(CAbase &ca, int mode, int engine, int n, double density) {
+    /* average time per cell and generation of one configuration */
+
+    Result r;
+    r.mode = mode;
+    r.engine = engine;
+    r.edge = n;
+    r.density = (mode == 1) ? -1 : density;
+    r.generations = 0;
+    r.nsPerCell = 0;
+    r.bytesPerCell = 0;
+    r.peakRss = 0;
+    r.outOfMemory = false;
+
+    try {
+        ca.setUniverseMode(mode);
+        ca.setPackedStorage(engine == EnginePacked);
+        ca.setTileWidth(engine == EngineColumn ? 1 : CAbase::defaultTileWidth);
+        ca.setCycleDetection(false);
+        ca.setSeed(42);
+        ca.lifeTimeUI = 50;
+        // release the planes of the previous run before the peak is reset
+        ca.resetWorldSize(2, 2);
+        resetPeakRss();
+        ca.resetWorldSize(n, n);
+        populate(ca, mode, n, density);
+    } catch (const std::bad_alloc &) {
+        r.outOfMemory = true;
+        return r;
+    }
+
+    double cells = double(n) * n;
+    r.bytesPerCell = ca.getStorageBytes() / cells;
+    r.generations = int(2e7 / cells) + 1;
+
+    // snake: a rectangle of side n / 3 within the universe
+    const int turns[4] = {8, 6, 2, 4};
+    int side = (n / 3 > 1) ? n / 3 : 1;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int g = 0; g < r.generations; g++) {
+        if (mode == 1) ca.directionSnake.future = turns[(g / side) % 4];
+        ca.worldEvolution();
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    r.nsPerCell = elapsed.count() / (cells * r.generations);
+    r.peakRss = peakRss();
+    return r;
+}
+
+
+static std::vector<std::string> split(const char *list) {
+    std::vector<std::string> items;
+    std::string item;
+    for (const char *c = list; ; c++) {
+        if (*c == ',' || *c == 0) {
+            if (!item.empty()) items.push_back(item);
+            item.clear();
+            if (*c == 0) break;
+        } else {
+            item += *c;
+        }
+    }
+    return items;
+}
+
+
+static int indexOf(const std::string &name, const char *const names[], int count) {
+    for (int i = 0; i < count; i++) {
+        if (name == names[i]) return i;
+    }
+    return -1;
+}
+
+
+static void printJson(const std::vector<Result> &results, int threads) {
+    printf("{\n  \"benchmark\": \"ca_benchmark\",\n  \"threads\": %d,\n  \"results\": [\n", threads);
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result &r = results[i];
+        printf("    {\"mode\": \"%s\", \"engine\": \"%s\", \"edge\": %d, ", modeNames[r.mode], engineNames[r.engine], r.edge);
+        if (r.density < 0) printf("\"density\": null, ");
+        else printf("\"density\": %g, ", r.density);
+        if (r.outOfMemory) {
+            printf("\"error\": \"out of memory\"}");
+        } else {
+            printf("\"generations\": %d, \"ns_per_cell\": %.4f, \"cells_per_second\": %.4e, "
+                   "\"bytes_per_cell\": %.3f, \"peak_rss_bytes\": %.0f}",
+                   r.generations, r.nsPerCell, 1e9 / r.nsPerCell, r.bytesPerCell, r.peakRss);
+        }
+        printf("%s\n", (i + 1 < results.size()) ? "," : "");
+    }
+    printf("  ]\n}\n");
+}
+
+
+int main(int argc, char *argv[]) {
+    bool json = false;
+    int threads = 1;
+    std::vector<int> sizes, modes, engineList;
+    std::vector<double> densities;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--json") {
+            json = true;
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (arg == "--modes" && i + 1 < argc) {
+            for (const std::string &m : split(argv[++i])) {
+                int mode = indexOf(m, modeNames, 8);
+                if (mode < 0) {
+                    fprintf(stderr, "unknown mode %s\n", m.c_str());
+                    return 2;
+                }
+                modes.push_back(mode);
+            }
+        } else if (arg == "--engines" && i + 1 < argc) {
+            for (const std::string &e : split(argv[++i])) {
+                int engine = indexOf(e, engineNames, 3);
+                if (engine < 0) {
+                    fprintf(stderr, "unknown engine %s\n", e.c_str());
+                    return 2;
+                }
+                engineList.push_back(engine);
+            }
+        } else if (arg == "--densities" && i + 1 < argc) {
+            for (const std::string &d : split(argv[++i])) densities.push_back(atof(d.c_str()));
+        } else if (arg[0] != '-') {
+            sizes.push_back(atoi(argv[i]));
+        } else {
+            fprintf(stderr, "usage: ca_benchmark [--json] [--modes life,snake,...] [--engines int,packed,column]\n"
+                            "                    [--densities 0.1,0.3,0.5] [--threads T] [edge length ...]\n");
+            return 2;
+        }
+    }
+    if (sizes.empty()) sizes = {64, 256, 1024, 4096, 16384};
+    if (modes.empty()) modes = {0, 1, 2, 3, 4, 5, 6, 7};
+    if (engineList.empty()) engineList = {EngineInt, EnginePacked};
+    if (densities.empty()) densities = {0.1, 0.3, 0.5};
+
+    // one automaton for all runs, resetWorldSize releases the planes of the previous run
+    CAbase ca;
+    ca.setThreadCount(threads);
+    std::vector<Result> results;
+
+    if (!json) {
+        printf("%-10s %-7s %8s %8s %12s %14s %11s %10s\n",
+               "mode", "engine", "edge", "density", "ns/cell", "cells/s", "bytes/cell", "peak MB");
+    }
+    for (int n : sizes) {
+        for (int mode : modes) {
+            for (int engine : engineList) {
+                // only the binary modes have packed planes
+                if (engine == EnginePacked && !CAbase::isBinaryMode(mode)) continue;
+                for (size_t d = 0; d < densities.size(); d++) {
+                    // the snake has no density
+                    if (mode == 1 && d > 0) break;
+                    Result r = run(ca, mode, engine, n, densities[d]);
+                    results.push_back(r);
+                    if (json) continue;
+
+                    char density[16] = "-";
+                    if (r.density >= 0) snprintf(density, sizeof(density), "%.2f", r.density);
+                    if (r.outOfMemory) {
+                        printf("%-10s %-7s %8d %8s   skipped: out of memory\n", modeNames[mode], engineNames[engine], n, density);
+                    } else {
+                        printf("%-10s %-7s %8d %8s %12.3f %14.4g %11.2f %10.1f\n", modeNames[mode], engineNames[engine],
+                               n, density, r.nsPerCell, 1e9 / r.nsPerCell, r.bytesPerCell, r.peakRss / 1048576);
+                    }
+                    fflush(stdout);
+                }
+            }
+        }
+    }
+    if (json) printJson(results, ca.getThreadCount());
+    return 0;
+}
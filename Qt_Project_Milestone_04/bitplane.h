@@ -0,0 +1,223 @@
+#ifndef BITPLANE_H
+#define BITPLANE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+inline int bitCount(uint64_t w) {
+    // living cells in a word
+#if defined(__GNUC__)
+    return __builtin_popcountll(w);
+#else
+    w = w - ((w >> 1) & 0x5555555555555555ULL);
+    w = (w & 0x3333333333333333ULL) + ((w >> 2) & 0x3333333333333333ULL);
+    w = (w + (w >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return int((w * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+
+class BitPlane {
+    /* bit-packed cell plane for the binary universe modes (64 cells per word)
+     *
+     * Every row holds the cells x = 0 .. Nx + 1 (border included). Cell x sits at bit position x + 63
+     * of its row, so the left border cell is the top bit of a padding word and the interior cells
+     * x = 1 .. Nx start word aligned at word 1. Each row is padded by one extra word on the right,
+     * which lets the word kernels read the left and right neighbour word of every interior word
+     * without any branches.
+     *
+     * The plane does not own its words; they are carved from the arena of the automaton.
+     */
+
+public:
+    BitPlane() :
+        nx(0),
+        ny(0),
+        words(0),
+        stride(0),
+        bits(nullptr)
+        {}
+
+    static size_t storageWords(int nx, int ny) {
+        // words needed for a plane of nx x ny interior cells
+        return (size_t) ((nx + 63) / 64 + 2) * (ny + 2);
+    }
+
+    void attach(int nxNew, int nyNew, uint64_t *storage) {
+        /* use storage (storageWords(nxNew, nyNew) words) for an empty plane of the given size */
+
+        nx = nxNew;
+        ny = nyNew;
+        words = (nx + 63) / 64;
+        stride = words + 2;
+        bits = storage;
+        clear();
+    }
+
+    void adopt(int nxNew, int nyNew, uint64_t *storage) {
+        /* use storage that already holds a plane of the given size, such as a mapped snapshot */
+
+        nx = nxNew;
+        ny = nyNew;
+        words = (nx + 63) / 64;
+        stride = words + 2;
+        bits = storage;
+    }
+
+    void clear() {
+        if (bits) memset(bits, 0, storageWords(nx, ny) * sizeof(uint64_t));
+    }
+
+    const uint64_t *data() const {
+        return bits;
+    }
+
+    void swap(BitPlane &other) {
+        uint64_t *b = bits;
+        bits = other.bits;
+        other.bits = b;
+    }
+
+    int get(int x, int y) const {
+        int p = x + 63;
+        return (bits[(size_t) y * stride + (p >> 6)] >> (p & 63)) & 1;
+    }
+
+    void set(int x, int y, int v) {
+        int p = x + 63;
+        uint64_t m = uint64_t(1) << (p & 63);
+        if (v) bits[(size_t) y * stride + (p >> 6)] |= m;
+        else bits[(size_t) y * stride + (p >> 6)] &= ~m;
+    }
+
+    int count(int y, int x0, int x1) const {
+        /* living cells x0 .. x1 of row y, a word at a time */
+
+        const uint64_t *r = &bits[(size_t) y * stride];
+        int p0 = x0 + 63, p1 = x1 + 63;
+        uint64_t first = ~uint64_t(0) << (p0 & 63);
+        uint64_t last = ~uint64_t(0) >> (63 - (p1 & 63));
+        if ((p0 >> 6) == (p1 >> 6)) return bitCount(r[p0 >> 6] & first & last);
+        int n = bitCount(r[p0 >> 6] & first) + bitCount(r[p1 >> 6] & last);
+        for (int i = (p0 >> 6) + 1; i < (p1 >> 6); i++) n += bitCount(r[i]);
+        return n;
+    }
+
+    uint64_t *row(int y) {
+        // first interior word of row y (row[-1] and row[words] are always valid)
+        return &bits[(size_t) y * stride + 1];
+    }
+
+    const uint64_t *row(int y) const {
+        return &bits[(size_t) y * stride + 1];
+    }
+
+    int getWords() const {
+        return words;
+    }
+
+    uint64_t lastWordMask() const {
+        // valid interior bits of the last interior word
+        int n = nx - 64 * (words - 1);
+        return (n == 64) ? ~uint64_t(0) : ((uint64_t(1) << n) - 1);
+    }
+
+    void fillHalo(bool torus) {
+        /* copy the opposite interior rows and columns into the border (toric case)
+         * or clear the border (hard wall) */
+
+        for (int y = 1; y <= ny; y++) {
+            set(0, y, torus ? get(nx, y) : 0);
+            set(nx + 1, y, torus ? get(1, y) : 0);
+        }
+        for (int i = 0; i < stride; i++) {
+            bits[i] = torus ? bits[(size_t) ny * stride + i] : 0;
+            bits[(size_t) (ny + 1) * stride + i] = torus ? bits[(size_t) stride + i] : 0;
+        }
+    }
+
+private:
+    int nx;
+    int ny;
+    int words;
+    int stride;
+    uint64_t *bits;
+};
+
+
+// row kernels evolve one interior row and return the cells that changed
+typedef uint64_t (*BitRowFunction)(const uint64_t *up, const uint64_t *mid, const uint64_t *down, uint64_t *out,
+                                   int words, uint64_t lastMask);
+
+
+// word kernels: bit k of every argument word belongs to the same cell column
+inline uint64_t bitWest(const uint64_t *r, int i) {
+    // value of the left neighbour of each cell of word i
+    return (r[i] << 1) | (r[i - 1] >> 63);
+}
+
+
+inline uint64_t bitEast(const uint64_t *r, int i) {
+    // value of the right neighbour of each cell of word i
+    return (r[i] >> 1) | (r[i + 1] << 63);
+}
+
+
+inline uint64_t bitCellNoise(const uint64_t *up, const uint64_t *mid, const uint64_t *down, int i) {
+    /* (center & up) ^ down ^ left ^ right ^ center */
+
+    return (mid[i] & up[i]) ^ down[i] ^ bitWest(mid, i) ^ bitEast(mid, i) ^ mid[i];
+}
+
+
+inline uint64_t bitCellErosion(const uint64_t *up, const uint64_t *mid, const uint64_t *down, int i) {
+    /* a cell survives if each of its four sides touches at least one living neighbour */
+
+    uint64_t upLeft = bitWest(up, i), upRight = bitEast(up, i);
+    uint64_t downLeft = bitWest(down, i), downRight = bitEast(down, i);
+    return mid[i] &
+           (up[i] | upLeft | upRight) &
+           (bitEast(mid, i) | downRight | upRight) &
+           (down[i] | downRight | downLeft) &
+           (bitWest(mid, i) | downLeft | upLeft);
+}
+
+
+template <uint64_t (*cell)(const uint64_t *, const uint64_t *, const uint64_t *, int)>
+inline uint64_t bitRow(const uint64_t *up, const uint64_t *mid, const uint64_t *down, uint64_t *out,
+                       int words, uint64_t lastMask) {
+    /* evolve one row word by word and return the cells that changed */
+
+    uint64_t changed = 0;
+    for (int i = 0; i < words - 1; i++) {
+        out[i] = cell(up, mid, down, i);
+        changed |= out[i] ^ mid[i];
+    }
+    // the last word may also hold the right border cell, which must stay clear in the result
+    out[words - 1] = cell(up, mid, down, words - 1) & lastMask;
+    changed |= (out[words - 1] ^ mid[words - 1]) & lastMask;
+    return changed;
+}
+
+
+inline void bitRotateBlocks(uint64_t &top, uint64_t &bottom, uint64_t blocks, uint64_t ccw) {
+    /* rotate the 2x2 Margolus blocks whose left cells are marked in blocks (even bits only);
+     * blocks marked in ccw rotate counter clockwise, all others clockwise */
+
+    uint64_t a = top & blocks, b = (top >> 1) & blocks;
+    uint64_t c = bottom & blocks, d = (bottom >> 1) & blocks;
+    ccw &= blocks;
+
+    uint64_t aNew = (c & ~ccw) | (b & ccw);
+    uint64_t bNew = (a & ~ccw) | (d & ccw);
+    uint64_t cNew = (d & ~ccw) | (a & ccw);
+    uint64_t dNew = (b & ~ccw) | (c & ccw);
+
+    uint64_t keep = ~(blocks | (blocks << 1));
+    top = (top & keep) | aNew | (bNew << 1);
+    bottom = (bottom & keep) | cNew | (dNew << 1);
+}
+
+
+#endif // BITPLANE_H
@@ -0,0 +1,34 @@
+#-------------------------------------------------
+#
+# Headless simulation of the cellular automata core (no Qt)
+#
+#-------------------------------------------------
+
+CONFIG   -= qt app_bundle
+CONFIG   += console c++11 thread
+
+TARGET = ca_cli
+TEMPLATE = app
+
+INCLUDEPATH += ..
+
+gcc: QMAKE_CXXFLAGS += -Wno-psabi
+
+SOURCES += \
+        main.cpp \
+        ../gameio.cpp \
+        ../hashlife.cpp \
+        ../patternio.cpp
+
+HEADERS += \
+        ../CAbase.h \
+        ../arena.h \
+        ../bitplane.h \
+        ../gameio.h \
+        ../hashlife.h \
+        ../lifekernel.h \
+        ../patternio.h \
+        ../philox.h \
+        ../rules.h \
+        ../threadpool.h \
+        ../zobrist.h
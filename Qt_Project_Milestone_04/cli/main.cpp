@@ -0,0 +1,337 @@
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <new>
+#include <string>
+
+#include "CAbase.h"
+#include "gameio.h"
+#include "hashlife.h"
+#include "patternio.h"
+
+/* Headless simulation
+ *
+ * Loads a saved game or fills a random universe from a seed, evolves it for the given number of
+ * generations as fast as the core allows, without timer or painting, and reports the timing. The
+ * run stops early once the universe comes to a halt, and skips whole periods once it is periodic.
+ *
+ * usage: ca_cli [options]
+ *   --mode M          life, snake, predator, noise, erosion, fluids, gases or rule (or 0 .. 7);
+ *                     taken from the file suffix when loading, life otherwise
+ *   --load FILE       saved game (.game_of_life, .snake, .predator), a Life pattern (.rle, .mc)
+ *                     centered in a universe of at least --size cells, or a snapshot (.snapshot)
+ *                     of any mode, which is mapped instead of read
+ *   --size N          edge length of a random universe (400)
+ *   --seed S          random seed of the initial universe and the evolution (time)
+ *   --density P       share of living cells in a random binary universe (0.3)
+ *   --lifetime L      lifetime of new predator-prey cells (50)
+ *   --rule B/S        rule of the custom rule mode (B3/S23)
+ *   --border B        torus or wall (torus)
+ *   --generations N   generations to evolve (1000)
+ *   --threads T       worker threads (1)
+ *   --unpacked        int planes instead of bit-packed planes for the binary modes
+ *   --hashlife        jump with HashLife (Life on the torus only)
+ *   --save FILE       final universe, in the binary format, as a pattern (.rle, .mc) or a snapshot
+ */
+
+static const char *modeNames[] = {"life", "snake", "predator", "noise", "erosion", "fluids", "gases", "rule"};
+
+
+static int parseMode(const char *s) {
+    for (int m = 0; m < 8; m++) {
+        if (strcmp(s, modeNames[m]) == 0) return m;
+    }
+    char *end;
+    long m = strtol(s, &end, 10);
+    return (*end == 0 && m >= 0 && m < 8) ? int(m) : -1;
+}
+
+
+static bool parseInt(const char *s, long &v) {
+    /* whole decimal number, false for anything else */
+
+    char *end;
+    v = strtol(s, &end, 10);
+    return end != s && *end == 0;
+}
+
+
+static bool parseCount(const char *s, uint64_t &v) {
+    /* whole decimal number that is not negative */
+
+    char *end;
+    v = strtoull(s, &end, 10);
+    return end != s && *end == 0 && *s != '-';
+}
+
+
+static bool parseReal(const char *s, double &v) {
+    char *end;
+    v = strtod(s, &end);
+    return end != s && *end == 0;
+}
+
+
+static int modeOfFile(const std::string &filename) {
+    /* universe mode from the suffix of a saved game */
+
+    for (int m = 0; m < 3; m++) {
+        std::string suffix = std::string(".") + gameFileSuffix(m);
+        if (filename.size() >= suffix.size() &&
+            filename.compare(filename.size() - suffix.size(), suffix.size(), suffix) == 0) return m;
+    }
+    return 0;
+}
+
+
+static bool resize(CAbase &ca, int mode, int size) {
+    /* empty universe of the given mode and size; false if its planes do not fit into memory */
+
+    ca.setUniverseMode(mode);
+    try {
+        ca.resetWorldSize(size, size);
+    } catch (const std::bad_alloc &) {
+        fprintf(stderr, "not enough memory for a %d x %d %s universe\n", size, size, modeNames[mode]);
+        return false;
+    }
+    return true;
+}
+
+
+static void populate(CAbase &ca, int mode, int n, double density, int lifetime) {
+    /* random initial universe, drawn from the seed of the automaton */
+
+    if (mode == 1) {
+        ca.putInitSnake();
+        ca.putNewFood();
+        return;
+    }
+    uint64_t threshold = uint64_t(density * 4294967296.0);
+    for (int y = 1; y <= n; y++) {
+        for (int x = 1; x <= n; x++) {
+            uint64_t r = ca.cellRandom(x, y, CAbase::RandomNoise);
+            if (mode == 2) {
+                // predators, prey and food
+                int kind = philoxBelow(r, 10);
+                if (kind == 0) {
+                    ca.setValue(x, y, 1);
+                    ca.setLifetime(x, y, lifetime);
+                } else if (kind <= 2) {
+                    ca.setValue(x, y, 2);
+                    ca.setLifetime(x, y, lifetime);
+                } else if (kind == 3) {
+                    ca.setValue(x, y, 5);
+                }
+            } else {
+                ca.setValue(x, y, (r >> 32) < threshold);
+            }
+        }
+    }
+}
+
+
+static uint64_t population(CAbase &ca) {
+    /* cells that are not empty */
+
+    uint64_t p = 0;
+    for (int y = 1; y <= ca.getNy(); y++) {
+        for (int x = 1; x <= ca.getNx(); x++) {
+            p += (ca.getValue(x, y) != 0);
+        }
+    }
+    return p;
+}
+
+
+static void usage() {
+    fprintf(stderr, "usage: ca_cli [--mode M] [--load FILE] [--size N] [--seed S] [--density P] [--lifetime L]\n"
+                    "              [--rule B/S] [--border torus|wall] [--generations N] [--threads T]\n"
+                    "              [--unpacked] [--hashlife] [--save FILE]\n");
+}
+
+
+int main(int argc, char *argv[]) {
+    int mode = -1;
+    int size = 400;
+    int lifetime = 50;
+    int threads = 1;
+    int border = CAbase::BorderTorus;
+    double density = 0.3;
+    uint64_t seed = uint64_t(time(NULL));
+    uint64_t generations = 1000;
+    bool packed = true;
+    bool hashlife = false;
+    std::string load, save, ruleText;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = (i + 1 < argc);
+        long number = 0;
+        bool valid = true;
+        if (arg == "--unpacked") {
+            packed = false;
+        } else if (arg == "--hashlife") {
+            hashlife = true;
+        } else if (!hasValue) {
+            usage();
+            return 2;
+        } else if (arg == "--mode") {
+            mode = parseMode(argv[++i]);
+            if (mode < 0) {
+                fprintf(stderr, "unknown mode %s\n", argv[i]);
+                return 2;
+            }
+        } else if (arg == "--load") {
+            load = argv[++i];
+        } else if (arg == "--save") {
+            save = argv[++i];
+        } else if (arg == "--size") {
+            valid = parseInt(argv[++i], number) && number >= 2;
+            size = int(number < INT_MAX ? number : INT_MAX);
+        } else if (arg == "--seed") {
+            valid = parseCount(argv[++i], seed);
+        } else if (arg == "--density") {
+            valid = parseReal(argv[++i], density) && density >= 0 && density <= 1;
+        } else if (arg == "--lifetime") {
+            valid = parseInt(argv[++i], number) && number >= 1 && number <= CAbase::maxLifetime;
+            lifetime = int(number);
+        } else if (arg == "--rule") {
+            ruleText = argv[++i];
+        } else if (arg == "--border") {
+            border = (strcmp(argv[++i], "wall") == 0) ? CAbase::BorderWall : CAbase::BorderTorus;
+        } else if (arg == "--generations") {
+            valid = parseCount(argv[++i], generations);
+        } else if (arg == "--threads") {
+            valid = parseInt(argv[++i], number) && number >= 1 && number < INT_MAX;
+            threads = int(number);
+        } else {
+            usage();
+            return 2;
+        }
+        if (!valid) {
+            fprintf(stderr, "invalid value %s for %s\n", argv[i], arg.c_str());
+            return 2;
+        }
+    }
+    bool snapshot = !load.empty() && isSnapshotFile(load);
+    if (mode < 0 && !snapshot) mode = load.empty() ? 0 : modeOfFile(load);
+
+    CAbase ca;
+    ca.setPackedStorage(packed);
+    if (mode >= 0 && size > ca.getMaxSize(mode)) {
+        // as large as the planes of the mode allow
+        fprintf(stderr, "warning: --size %d exceeds the largest %s universe, using %d\n", size, modeNames[mode],
+                ca.getMaxSize(mode));
+        size = ca.getMaxSize(mode);
+    }
+    ca.setBorderMode(border);
+    ca.setThreadCount(threads);
+    ca.setSeed(seed);
+    ca.lifeTimeUI = lifetime;
+    if (!ruleText.empty()) {
+        LifeRule rule;
+        if (!parseRule(ruleText, rule)) {
+            fprintf(stderr, "invalid rule %s, expected B/S notation such as B3/S23\n", ruleText.c_str());
+            return 2;
+        }
+        ca.setRule(rule);
+    }
+
+    // initial universe
+    GameFile settings;
+    if (snapshot) {
+        // the snapshot brings its own mode, size, border, rule and seed
+        auto opened = std::chrono::steady_clock::now();
+        if (!ca.loadSnapshot(load.c_str(), mode)) {
+            fprintf(stderr, "could not load %s as a snapshot%s%s\n", load.c_str(), mode < 0 ? "" : " of ",
+                    mode < 0 ? "" : modeNames[mode]);
+            return 1;
+        }
+        std::chrono::duration<double> openTime = std::chrono::steady_clock::now() - opened;
+        mode = ca.getUniverseMode();
+        border = ca.getBorderMode();
+        printf("snapshot     %s mapped in %.6f s\n", load.c_str(), openTime.count());
+    } else if (!load.empty() && patternFormatOfFile(load) >= 0) {
+        std::ifstream in(load.c_str(), std::ios::binary);
+        LifeRule rule;
+        if (!resize(ca, mode, size)) return 1;
+        if (!in || !readPattern(in, patternFormatOfFile(load), ca, rule)) {
+            fprintf(stderr, "could not load %s as a %s pattern\n", load.c_str(), modeNames[mode]);
+            return 1;
+        }
+        // the rule of the pattern, unless one was given
+        if (mode == 7 && ruleText.empty()) ca.setRule(rule);
+        if (mode == 0 && ruleString(rule) != ruleString(makeRule(RULE_LIFE))) {
+            fprintf(stderr, "warning: %s is a %s pattern, evolved as Life\n", load.c_str(), ruleString(rule).c_str());
+        }
+    } else if (!load.empty()) {
+        std::ifstream in(load.c_str(), std::ios::binary);
+        if (!in || !readGame(in, mode, ca, settings)) {
+            fprintf(stderr, "could not load %s as a %s game\n", load.c_str(), modeNames[mode]);
+            return 1;
+        }
+        if (mode == 2) ca.lifeTimeUI = settings.lifetime;
+    } else {
+        if (!resize(ca, mode, size)) return 1;
+        populate(ca, mode, size, density, lifetime);
+    }
+    uint64_t startGeneration = ca.getGeneration();
+
+    // evolution
+    uint64_t evolved = generations;
+    auto start = std::chrono::steady_clock::now();
+    if (hashlife) {
+        if (mode != 0 || border != CAbase::BorderTorus) {
+            fprintf(stderr, "HashLife only runs the Game of Life on the torus\n");
+            return 2;
+        }
+        HashLife engine;
+        engine.jump(ca, generations);
+    } else {
+        evolved = ca.evolveGenerations(generations);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    double cells = double(ca.getNx()) * ca.getNy();
+    printf("mode         %s\n", modeNames[mode]);
+    printf("universe     %d x %d, %s, %s planes, %d threads\n", ca.getNx(), ca.getNy(),
+           border == CAbase::BorderTorus ? "torus" : "wall", ca.isPacked() ? "bit-packed" : "int", ca.getThreadCount());
+    printf("seed         %llu\n", (unsigned long long) ca.getSeed());
+    printf("generations  %llu (generation %llu to %llu)\n", (unsigned long long) evolved,
+           (unsigned long long) startGeneration, (unsigned long long) ca.getGeneration());
+    if (evolved < generations) {
+        printf("halted       %s after %llu generations\n", mode == 1 ? "snake died" : "no further changes",
+               (unsigned long long) evolved);
+    }
+    if (ca.getCyclePeriod() > 0) {
+        printf("periodic     period %llu since generation %llu\n",
+               (unsigned long long) ca.getCyclePeriod(), (unsigned long long) ca.getCycleStart());
+    }
+    printf("seconds      %.6f\n", elapsed.count());
+    if (elapsed.count() > 0) {
+        printf("rate         %.1f generations/s, %.3f ns/cell\n", evolved / elapsed.count(),
+               elapsed.count() * 1e9 / (cells * (evolved > 0 ? evolved : 1)));
+    }
+    printf("population   %llu\n", (unsigned long long) population(ca));
+
+    // final universe
+    if (!save.empty() && isSnapshotFile(save)) {
+        if (!ca.saveSnapshot(save.c_str())) {
+            fprintf(stderr, "could not write %s\n", save.c_str());
+            return 1;
+        }
+    } else if (!save.empty()) {
+        std::ofstream out(save.c_str(), std::ios::binary);
+        if (patternFormatOfFile(save) >= 0) writePattern(out, patternFormatOfFile(save), ca);
+        else writeGame(out, ca, settings);
+        if (!out) {
+            fprintf(stderr, "could not write %s\n", save.c_str());
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,641 @@
+#include <vector>
+#include "gameio.h"
+
+
+static void appendCode(std::string &s, uint32_t c) {
+    /* append code point c as UTF-8: long snakes and lifetimes reach beyond ASCII */
+
+    if (c < 0x80) {
+        s += char(c);
+    } else if (c < 0x800) {
+        s += char(0xC0 | (c >> 6));
+        s += char(0x80 | (c & 0x3F));
+    } else if (c < 0x10000) {
+        s += char(0xE0 | (c >> 12));
+        s += char(0x80 | ((c >> 6) & 0x3F));
+        s += char(0x80 | (c & 0x3F));
+    } else {
+        s += char(0xF0 | (c >> 18));
+        s += char(0x80 | ((c >> 12) & 0x3F));
+        s += char(0x80 | ((c >> 6) & 0x3F));
+        s += char(0x80 | (c & 0x3F));
+    }
+}
+
+
+static uint32_t nextCode(const std::string &s, size_t &i) {
+    /* decode the UTF-8 code point at s[i] and move i past it */
+
+    uint32_t c = (unsigned char) s[i++];
+    int follow = (c >= 0xF0) ? 3 : (c >= 0xE0) ? 2 : (c >= 0xC0) ? 1 : 0;
+    if (follow) c &= 0x3F >> follow;
+    for (; follow > 0 && i < s.size(); follow--) {
+        c = (c << 6) | ((unsigned char) s[i++] & 0x3F);
+    }
+    return c;
+}
+
+
+const char *gameFileSuffix(int mode) {
+    /* file name suffix of the saved games of a universe mode */
+
+    switch (mode) {
+    case 1: return "snake";
+    case 2: return "predator";
+    default: return "game_of_life";
+    }
+}
+
+
+bool isSnapshotFile(const std::string &filename) {
+    /* whether a file name has the suffix of snapshots */
+
+    static const std::string suffix = ".snapshot";
+    return filename.size() >= suffix.size() &&
+           filename.compare(filename.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+
+static bool validValue(int mode, bool lifetime, int64_t v, uint64_t cells) {
+    /* whether v is a cell value (or a lifetime) of the mode in a universe of the given number of cells */
+
+    if (lifetime) return v >= 0 && v <= CAbase::maxLifetime;
+    switch (mode) {
+    case 1: return v == 0 || v == 5 || (v >= 10 && uint64_t(v - 10) < cells); // food and body segments
+    case 2: return v == 0 || v == 1 || v == 2 || v == 5; // predator, prey and food
+    default: return v == 0 || v == 1;
+    }
+}
+
+
+std::string dumpCells(CAbase &ca, char member) {
+    /* one line of characters per row of the current universe */
+
+    int nx = ca.getNx(), ny = ca.getNy();
+    std::string master;
+    // one character per cell plus a newline per row
+    master.reserve((size_t) ny * (nx + 1));
+
+    for (int k = 1; k <= ny; k++) {
+        for (int j = 1; j <= nx; j++) {
+            int value = ca.getValue(j, k);
+            switch (ca.getUniverseMode()) {
+
+            // SNAKE
+            case 1:
+                if (value == 5) {
+                    master += 'F';
+                } else if (value >= 10) {
+                    appendCode(master, 'H' + value - 10);
+                } else {
+                    master += 'G';
+                }
+                break;
+
+            // PREDATOR
+            case 2:
+                if (member == 'l') { // lifetime
+                    int lT = ca.getLifetime(j, k);
+                    if (lT == CAbase::maxLifetime) {
+                        master += 'A';
+                    } else {
+                        appendCode(master, 'B' + (lT > 0 ? lT : 0));
+                    }
+                } else if (value == 1) {
+                    master += 'J';
+                } else if (value == 2) {
+                    master += 'G';
+                } else if (value == 5) {
+                    master += 'F';
+                } else {
+                    master += 'o';
+                }
+                break;
+
+            // GAME OF LIFE and the other binary modes
+            default:
+                master += (value == 1) ? '*' : 'o';
+                break;
+            }
+        }
+        master += '\n';
+    }
+    return master;
+}
+
+
+bool reconstructCells(CAbase &ca, const std::string &data, char member) {
+    /* set the cells of the current universe from a dump; false for a snake segment or lifetime that
+     * does not fit the universe, which is then only partly set */
+
+    int nx = ca.getNx(), ny = ca.getNy();
+    uint64_t cells = uint64_t(nx) * ny;
+    size_t current = 0;
+
+    for (int k = 1; k <= ny && current < data.size(); k++) {
+        for (int j = 1; j <= nx && current < data.size() && data[current] != '\n'; j++) {
+            uint32_t c = nextCode(data, current);
+            switch (ca.getUniverseMode()) {
+
+            // SNAKE
+            case 1:
+                if (c == 'F') {
+                    ca.setValue(j, k, 5);
+                } else if (c >= 'H') {
+                    if (!validValue(1, false, 10 + int64_t(c - 'H'), cells)) return false;
+                    ca.setValue(j, k, 10 + int(c - 'H'));
+                } else {
+                    ca.setValue(j, k, 0);
+                }
+                break;
+
+            // PREDATOR
+            case 2:
+                if (member == 'l') {
+                    if (c == 'A') {
+                        ca.setLifetime(j, k, CAbase::maxLifetime);
+                    } else if (c >= 'B') {
+                        if (!validValue(2, true, int64_t(c - 'B'), cells)) return false;
+                        ca.setLifetime(j, k, int(c - 'B'));
+                    }
+                } else if (c == 'F') {
+                    ca.setValue(j, k, 5);
+                } else if (c == 'G') {
+                    ca.setValue(j, k, 2);
+                } else if (c == 'J') {
+                    ca.setValue(j, k, 1);
+                } else {
+                    ca.setValue(j, k, 0);
+                }
+                break;
+
+            // GAME OF LIFE and the other binary modes
+            default:
+                ca.setValue(j, k, c == '*');
+                break;
+            }
+        }
+        // skip the rest of the row
+        while (current < data.size() && data[current++] != '\n') {}
+    }
+    return true;
+}
+
+
+static bool readRows(std::istream &in, int size, std::string &dump) {
+    /* the next size rows of a dump */
+
+    std::string row;
+    dump.clear();
+    for (int k = 0; k != size; k++) {
+        if (!(in >> row)) return false;
+        dump += row + "\n";
+    }
+    return true;
+}
+
+
+static void readSeed(std::istream &in, CAbase &ca, GameFile &game) {
+    /* restore random seed and generation; files written before they were saved have neither */
+
+    uint64_t seed, generation;
+    if (!(in >> seed >> generation)) return;
+    ca.setSeed(seed);
+    ca.setGeneration(generation);
+    game.hasSeed = true;
+}
+
+
+// BINARY FORMAT
+
+static const char binaryMagic[8] = {'C', 'A', 'G', 'A', 'M', 'E', '\x1A', '\n'};
+static const uint64_t binaryVersion = 1;
+static const size_t binaryBuffer = 1 << 16;  // bytes buffered between the stream and the rows
+
+enum binaryPlanes {
+    PlaneCells,      // cell values
+    PlaneLifetimes   // predator-prey lifetimes
+};
+
+enum binaryEncodings {
+    EncodingWords,   // bit rows of 64 cells per word (binary modes)
+    EncodingRuns     // runs of equal values (int planes)
+};
+
+
+class BinaryWriter {
+    /* little-endian words and variable-length integers, buffered into an ostream */
+
+public:
+    explicit BinaryWriter(std::ostream &o) :
+        out(o)
+        { buffer.reserve(binaryBuffer + 64); }
+
+    ~BinaryWriter() {
+        flush();
+    }
+
+    void putBytes(const char *b, size_t n) {
+        buffer.append(b, n);
+        if (buffer.size() >= binaryBuffer) flush();
+    }
+
+    void putVarint(uint64_t v) {
+        // 7 bits per byte, low bits first, the top bit marks that more bytes follow
+        while (v >= 0x80) {
+            buffer += char(0x80 | (v & 0x7F));
+            v >>= 7;
+        }
+        buffer += char(v);
+        if (buffer.size() >= binaryBuffer) flush();
+    }
+
+    void putInt(int64_t v) {
+        // zigzag: small negative numbers stay short
+        putVarint((uint64_t(v) << 1) ^ uint64_t(v >> 63));
+    }
+
+    void putWord(uint64_t w) {
+        char b[8];
+        for (int i = 0; i < 8; i++) b[i] = char(w >> (8 * i));
+        putBytes(b, 8);
+    }
+
+    void flush() {
+        out.write(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+
+private:
+    std::ostream &out;
+    std::string buffer;
+};
+
+
+class BinaryReader {
+    /* counterpart of BinaryWriter; ok() turns false for good at the end of the stream */
+
+public:
+    explicit BinaryReader(std::istream &i) :
+        in(i),
+        buffer(binaryBuffer),
+        pos(0),
+        end(0),
+        good(true)
+        {}
+
+    bool ok() const {
+        return good;
+    }
+
+    void fail() {
+        good = false;
+    }
+
+    int getByte() {
+        if (pos == end) {
+            in.read(buffer.data(), buffer.size());
+            pos = 0;
+            end = in.gcount();
+            if (end == 0) {
+                good = false;
+                return 0;
+            }
+        }
+        return (unsigned char) buffer[pos++];
+    }
+
+    uint64_t getVarint() {
+        uint64_t v = 0;
+        for (int shift = 0; shift < 64 && good; shift += 7) {
+            int b = getByte();
+            v |= uint64_t(b & 0x7F) << shift;
+            if (!(b & 0x80)) return v;
+        }
+        good = false;
+        return 0;
+    }
+
+    int64_t getInt() {
+        uint64_t v = getVarint();
+        return int64_t(v >> 1) ^ -int64_t(v & 1);
+    }
+
+    uint64_t getWord() {
+        uint64_t w = 0;
+        for (int i = 0; i < 8; i++) w |= uint64_t(getByte()) << (8 * i);
+        return w;
+    }
+
+private:
+    std::istream &in;
+    std::vector<char> buffer;
+    size_t pos;
+    size_t end;
+    bool good;
+};
+
+
+static void writeWords(BinaryWriter &w, const uint64_t *row, int n) {
+    /* bit row of n words: runs of equal words (empty areas) as one word, the rest literally
+     *
+     * Each token starts with a varint h: h & 1 is a run of h >> 1 copies of the next word,
+     * otherwise h >> 1 literal words follow.
+     */
+
+    int i = 0;
+    while (i < n) {
+        int j = i + 1;
+        while (j < n && row[j] == row[i]) j++;
+        if (j - i >= 2) {
+            w.putVarint(uint64_t(j - i) << 1 | 1);
+            w.putWord(row[i]);
+            i = j;
+            continue;
+        }
+        // literal words up to the next run
+        j = i + 1;
+        while (j < n && !(j + 1 < n && row[j + 1] == row[j])) j++;
+        w.putVarint(uint64_t(j - i) << 1);
+        for (; i < j; i++) w.putWord(row[i]);
+    }
+}
+
+
+static void readWords(BinaryReader &r, uint64_t *row, int n) {
+    int i = 0;
+    while (i < n && r.ok()) {
+        uint64_t h = r.getVarint();
+        uint64_t c = h >> 1;
+        if (c == 0 || c > uint64_t(n - i)) {
+            r.fail();
+            return;
+        }
+        if (h & 1) {
+            uint64_t word = r.getWord();
+            for (uint64_t k = 0; k < c; k++) row[i++] = word;
+        } else {
+            for (uint64_t k = 0; k < c; k++) row[i++] = r.getWord();
+        }
+    }
+}
+
+
+static void writeRuns(BinaryWriter &w, const int *row, int n) {
+    /* row of n values as pairs of run length and value */
+
+    int i = 0;
+    while (i < n) {
+        int j = i + 1;
+        while (j < n && row[j] == row[i]) j++;
+        w.putVarint(j - i);
+        w.putInt(row[i]);
+        i = j;
+    }
+}
+
+
+static void readRuns(BinaryReader &r, int *row, int n) {
+    int i = 0;
+    while (i < n && r.ok()) {
+        uint64_t c = r.getVarint();
+        int64_t v = r.getInt();
+        if (c == 0 || c > uint64_t(n - i) || v != int64_t(int(v))) {
+            r.fail();
+            return;
+        }
+        for (uint64_t k = 0; k < c; k++) row[i++] = int(v);
+    }
+}
+
+
+static void writeBinaryGame(std::ostream &out, CAbase &ca, const GameFile &game) {
+    /* header and one chunk per plane, written a row at a time */
+
+    BinaryWriter w(out);
+    CAview v = ca.view();
+    int mode = ca.getUniverseMode(), nx = ca.getNx(), ny = ca.getNy();
+
+    w.putBytes(binaryMagic, sizeof(binaryMagic));
+    w.putVarint(binaryVersion);
+    w.putVarint(mode);
+    w.putVarint(nx);
+    w.putVarint(ny);
+    w.putVarint(ca.getSeed());
+    w.putVarint(ca.getGeneration());
+    w.putInt(game.red);
+    w.putInt(game.green);
+    w.putInt(game.blue);
+    w.putInt(game.interval);
+    w.putInt(game.cellMode);
+    w.putInt(game.lifetime);
+    // snake state, written for every mode to keep the header fixed
+    w.putInt(ca.directionSnake.past);
+    w.putInt(ca.directionSnake.future);
+    w.putInt(ca.getSnakeLength());
+    w.putInt(ca.getSnakeAction());
+    w.putInt(ca.positionSnakeHead.x);
+    w.putInt(ca.positionSnakeHead.y);
+    w.putInt(ca.positionFood.x);
+    w.putInt(ca.positionFood.y);
+
+    if (CAbase::isBinaryMode(mode)) {
+        std::vector<uint64_t> row((nx + 63) / 64);
+        w.putVarint(1);
+        w.putVarint(PlaneCells);
+        w.putVarint(EncodingWords);
+        for (int k = 1; k <= ny; k++) {
+            v.packRow(k, row.data());
+            writeWords(w, row.data(), row.size());
+        }
+        return;
+    }
+
+    std::vector<int> row(nx);
+    w.putVarint(mode == 2 ? 2 : 1);
+    w.putVarint(PlaneCells);
+    w.putVarint(EncodingRuns);
+    for (int k = 1; k <= ny; k++) {
+        for (int j = 1; j <= nx; j++) row[j - 1] = v.getValue(j, k);
+        writeRuns(w, row.data(), nx);
+    }
+    if (mode == 2) {
+        w.putVarint(PlaneLifetimes);
+        w.putVarint(EncodingRuns);
+        for (int k = 1; k <= ny; k++) {
+            for (int j = 1; j <= nx; j++) row[j - 1] = v.getLifetime(j, k);
+            writeRuns(w, row.data(), nx);
+        }
+    }
+}
+
+
+static bool readBinaryGame(std::istream &in, int mode, CAbase &ca, GameFile &game) {
+    /* counterpart of writeBinaryGame; the binary modes share their files. Every value is checked
+     * against the mode, ca is only a scratch automaton (see readGame) */
+
+    BinaryReader r(in);
+    for (size_t i = 0; i < sizeof(binaryMagic); i++) {
+        if (r.getByte() != (unsigned char) binaryMagic[i]) return false;
+    }
+    if (r.getVarint() != binaryVersion) return false;
+    int fileMode = int(r.getVarint());
+    uint64_t nx = r.getVarint(), ny = r.getVarint();
+    if (!r.ok() || !(fileMode == mode || (CAbase::isBinaryMode(fileMode) && CAbase::isBinaryMode(mode)))) return false;
+    // universes are square, the GUI relies on it
+    if (nx < 1 || nx != ny || nx > uint64_t(ca.getMaxSize(mode))) return false;
+
+    uint64_t seed = r.getVarint(), generation = r.getVarint();
+    game.size = int(nx);
+    game.red = int(r.getInt());
+    game.green = int(r.getInt());
+    game.blue = int(r.getInt());
+    game.interval = int(r.getInt());
+    game.cellMode = int(r.getInt());
+    game.lifetime = int(r.getInt());
+
+    ca.setUniverseMode(mode);
+    ca.resetWorldSize(int(nx), int(ny));
+    ca.directionSnake.past = int(r.getInt());
+    ca.directionSnake.future = int(r.getInt());
+    ca.setSnakeLength(int(r.getInt()));
+    ca.setSnakeAction(int(r.getInt()));
+    ca.positionSnakeHead.x = int(r.getInt());
+    ca.positionSnakeHead.y = int(r.getInt());
+    ca.positionFood.x = int(r.getInt());
+    ca.positionFood.y = int(r.getInt());
+
+    std::vector<uint64_t> words((nx + 63) / 64);
+    std::vector<int> values(nx);
+    // every plane of the mode exactly once: the cells, and the lifetimes for predator-prey
+    unsigned seen = 0, expected = (mode == 2) ? 3 : 1;
+    uint64_t planes = r.getVarint();
+    if (planes > 2) return false;
+    for (; planes > 0 && r.ok(); planes--) {
+        uint64_t plane = r.getVarint(), encoding = r.getVarint();
+        if (plane > PlaneLifetimes || (seen & (1u << plane))) return false;
+        seen |= 1u << plane;
+        if (encoding == EncodingWords && plane == PlaneCells && CAbase::isBinaryMode(mode)) {
+            for (int k = 1; k <= int(ny) && r.ok(); k++) {
+                readWords(r, words.data(), words.size());
+                ca.setRow(k, words.data());
+            }
+        } else if (encoding == EncodingRuns && (plane == PlaneCells || (plane == PlaneLifetimes && mode == 2))) {
+            for (int k = 1; k <= int(ny) && r.ok(); k++) {
+                readRuns(r, values.data(), int(nx));
+                for (int j = 1; j <= int(nx) && r.ok(); j++) {
+                    if (!validValue(mode, plane == PlaneLifetimes, values[j - 1], nx * ny)) return false;
+                    if (plane == PlaneCells) ca.setValue(j, k, values[j - 1]);
+                    else ca.setLifetime(j, k, values[j - 1]);
+                }
+            }
+        } else {
+            return false;
+        }
+    }
+    if (!r.ok() || seen != expected) return false;
+
+    ca.setSeed(seed);
+    ca.setGeneration(generation);
+    game.hasSeed = true;
+    return true;
+}
+
+
+// TEXT FORMAT
+
+static bool readTextGame(std::istream &in, int mode, CAbase &ca, GameFile &game) {
+    /* universe and settings of a text file of an earlier version */
+
+    std::string dump;
+    int size, r, g, b, interval;
+
+    if (!(in >> size) || size < 1 || size > ca.getMaxSize(mode)) return false;
+    game.size = size;
+    ca.setUniverseMode(mode);
+    ca.resetWorldSize(size, size);
+
+    switch (mode) {
+
+    // SNAKE
+    case 1: {
+        int past, future, length, action, hx, hy, fx, fy;
+        if (!(in >> r >> g >> b >> interval >> past >> future >> length >> action >> hx >> hy >> fx >> fy)) return false;
+        game.red = r;
+        game.green = g;
+        game.blue = b;
+        game.interval = interval;
+        ca.directionSnake.past = past;
+        ca.directionSnake.future = future;
+        ca.setSnakeLength(length);
+        ca.setSnakeAction(action);
+        ca.positionSnakeHead.x = hx;
+        ca.positionSnakeHead.y = hy;
+        ca.positionFood.x = fx;
+        ca.positionFood.y = fy;
+
+        if (!readRows(in, size, dump)) return false;
+        if (!reconstructCells(ca, dump)) return false;
+        readSeed(in, ca, game);
+        break;
+    }
+
+    // PREDATOR
+    case 2:
+        if (!(in >> r >> g >> b >> interval >> game.cellMode)) return false;
+        game.red = r;
+        game.green = g;
+        game.blue = b;
+        game.interval = interval;
+
+        if (!readRows(in, size, dump)) return false;
+        if (!reconstructCells(ca, dump)) return false;
+
+        if (!(in >> game.lifetime)) return false;
+        if (!readRows(in, size, dump)) return false;
+        if (!reconstructCells(ca, dump, 'l')) return false;
+        readSeed(in, ca, game);
+        break;
+
+    // GAME OF LIFE and the other binary modes: color and interval follow the cells
+    default:
+        if (!readRows(in, size, dump)) return false;
+        if (!reconstructCells(ca, dump)) return false;
+        if (in >> r >> g >> b >> interval) {
+            game.red = r;
+            game.green = g;
+            game.blue = b;
+            game.interval = interval;
+        }
+        break;
+    }
+    return true;
+}
+
+
+bool readGame(std::istream &in, int mode, CAbase &ca, GameFile &game) {
+    /* reset ca to the universe of a saved game of the given mode; returns false for a malformed file,
+     * leaving ca and game as they were */
+
+    // the file is decoded into an automaton of its own, which hands its universe over once it is complete
+    CAbase next(1, 1);
+    next.setPackedStorage(ca.getPackedStorage());
+    GameFile file = game;
+
+    // binary files start with their magic, text files with the universe size
+    bool ok = (in.peek() == binaryMagic[0]) ? readBinaryGame(in, mode, next, file) : readTextGame(in, mode, next, file);
+    // the state of the snake is derived from its body, never taken from the file
+    if (!ok || (mode == 1 && !next.rebuildSnake())) return false;
+    if (!file.hasSeed) next.setSeed(ca.getSeed());
+
+    ca.adoptUniverse(next);
+    game = file;
+    return true;
+}
+
+
+void writeGame(std::ostream &out, CAbase &ca, const GameFile &game) {
+    /* save the current universe of ca in the binary format */
+
+    writeBinaryGame(out, ca, game);
+}
@@ -0,0 +1,72 @@
+#ifndef GAMEIO_H
+#define GAMEIO_H
+
+#include <stdint.h>
+#include <istream>
+#include <ostream>
+#include <string>
+#include "CAbase.h"
+
+/* Saved games (.game_of_life, .snake, .predator)
+ *
+ * Files shared by the GUI and the headless CLI. Games are saved in a versioned binary format:
+ * an 8 byte magic, then variable-length integers for the version, mode, size, random seed,
+ * generation, the settings below and the snake state, then one chunk per cell plane. The binary
+ * modes store every row as 64 cells per word, with runs of equal words (empty areas) collapsed;
+ * Snake and predator-prey store runs of equal values, for the cells and the lifetimes. Files are
+ * written and read a row at a time. A file is decoded into a universe of its own and checked in
+ * full, value by value, before it replaces the current one, which a malformed file leaves as it was.
+ * Universes are square; predator-prey files must hold both planes.
+ *
+ * Text files of earlier versions still load: the universe size, the settings of the game and one
+ * line of characters per row of cells. Life writes '*' for living and 'o' for dead cells; the other
+ * binary modes use the same layout. Snake writes 'F' for food, 'H' + k for body segment k and 'G'
+ * for empty cells. Predator-prey writes 'J' predator, 'G' prey, 'F' food and 'o' empty cells,
+ * followed by a second block with the lifetimes. Snake and predator-prey files end with the random
+ * seed and the generation, which older files do not have.
+ *
+ * Snapshots (.snapshot) are no games but images of the memory of the automaton of any mode, see
+ * CAbase::saveSnapshot; they are mapped when loaded, which takes no time even for huge packed
+ * universes. The cells of an unpacked universe are read once to check them.
+ */
+
+struct GameFile {
+    /* settings stored next to the cells */
+
+    GameFile() :
+        size(0),
+        red(0),
+        green(0),
+        blue(0),
+        interval(300),
+        cellMode(0),
+        lifetime(50),
+        hasSeed(false)
+        {}
+
+    int size;           // cells per row and column
+    int red;            // cell color
+    int green;
+    int blue;
+    int interval;       // msec between two generations
+    int cellMode;       // predator-prey only: cells added by mouse clicks
+    int lifetime;       // predator-prey only: lifetime of new cells
+    bool hasSeed;       // whether the file held seed and generation, which are then set on the automaton
+                        // (always for binary files)
+};
+
+
+const char *gameFileSuffix(int mode);
+
+bool isSnapshotFile(const std::string &filename);
+
+std::string dumpCells(CAbase &ca, char member = 'v');
+
+bool reconstructCells(CAbase &ca, const std::string &data, char member = 'v');
+
+bool readGame(std::istream &in, int mode, CAbase &ca, GameFile &game);
+
+void writeGame(std::ostream &out, CAbase &ca, const GameFile &game);
+
+
+#endif // GAMEIO_H
@@ -1,37 +1,53 @@
 #include <QMessageBox>
 #include <QTimer>
 #include <QMouseEvent>
+#include <QWheelEvent>
 #include <QDebug>
 #include <QRectF>
 #include <QString>
 #include <QPainter>
 #include <QTime>
 
+#include <new>
 #include <qmath.h>
 #include "gamewidget.h"
+#include "patternio.h"
 #include "keypressfilter.h"
 
 
 GameWidget::GameWidget(QWidget *parent) :
     QWidget(parent),
-    timer(new QTimer(this)),
-    timerColor(new QTimer(this)),
+    timerRate(new QTimer(this)),
+    rateEvolved(0),
     ca1(),
+    simulation(ca1),
     universeSize(50),
     universeMode(0),
     cellMode(0),
     lifeTime(50),
-    generations(-1)
+    interval(300),
+    turbo(false),
+    viewX(0),
+    viewY(0),
+    zoom(1),
+    viewFitted(true)
     //randomMode(0)
 
 {
-    timer->setInterval(300);
-    timerColor->setInterval(50);
+    timerRate->setInterval(1000);
     masterColor = "#000";
-    ca1.resetWorldSize(universeSize, universeSize);
-    ca1.lifeTimeUI = lifeTime;
-    connect(timer, SIGNAL(timeout()), this, SLOT(newGeneration()));
-    connect(timerColor, SIGNAL(timeout()), this, SLOT(newGenerationColor()));
+    updatePalette();
+    {
+        Simulation::Access access(simulation);
+        ca1.resetWorldSize(universeSize, universeSize);
+        ca1.lifeTimeUI = lifeTime;
+        access.modified();
+    }
+    // finished generations arrive from the worker thread
+    connect(&simulation, SIGNAL(frameReady()), this, SLOT(update()));
+    connect(&simulation, SIGNAL(halted(int, qulonglong, qulonglong)),
+            this, SLOT(evolutionHalted(int, qulonglong, qulonglong)));
+    connect(timerRate, SIGNAL(timeout()), this, SLOT(measureRate()));
 }
 
 
@@ -43,8 +59,10 @@ void GameWidget::startGame(const int &number) {
     /* start the game */
 
     emit gameStarted(universeMode, true);
-    generations = number;
-    timer->start();
+    simulation.startEvolution(number);
+    rateEvolved = simulation.getEvolved();
+    rateClock.start();
+    timerRate->start();
     this->setFocus();
 }
 
@@ -53,40 +71,54 @@ void GameWidget::stopGame() {
     /* stop the game */
 
     emit gameStopped(universeMode, true);
-    timer->stop();
-    timerColor->stop();
+    simulation.stopEvolution();
+    if (timerRate->isActive()) {
+        timerRate->stop();
+        measureRate();
+    }
 }
 
 
 void GameWidget::clearGame() {
     /* clear the field and reset parameters if necessary */
 
-    for (int k = 1; k <= universeSize; k++) {
-        for (int j = 1; j <= universeSize; j++) {
-            ca1.setValue(j, k, 0);
-        }
-    }
     gameEnds(universeMode, true);
-    //qDebug() << "clearGame -> resetWorldsize()";
-    ca1.resetWorldSize(universeSize, universeSize);
 
-    // snake
-    if (universeMode == 1) {
-        ca1.putInitSnake();
-        ca1.putNewFood();
-    // predator-prey
-    } else if (universeMode == 2) {
-        for (int k = 1; k <= universeSize; k++) {
-            for (int j = 1; j <= universeSize; j++) {
-                ca1.setLifetime(j, k, ca1.maxLifetime);
+    {
+        Simulation::Access access(simulation);
+        // Snake and Predator keep int planes, which only go up to maxIntSize
+        universeSize = qMin(universeSize, ca1.getMaxSize(universeMode));
+        //qDebug() << "clearGame -> resetWorldsize()";
+        ca1.resetWorldSize(universeSize, universeSize);
+
+        // snake
+        if (universeMode == 1) {
+            ca1.putInitSnake();
+            ca1.putNewFood();
+        // predator-prey
+        } else if (universeMode == 2) {
+            for (int k = 1; k <= universeSize; k++) {
+                for (int j = 1; j <= universeSize; j++) {
+                    ca1.setLifetime(j, k, ca1.maxLifetime);
+                }
             }
+        // all modeling games
+        } else if (universeMode >= 3) {
+            //ca1.generateInitRandomNoise();
         }
-    // all modeling games
-    } else if (universeMode >= 3) {
-        //ca1.generateInitRandomNoise();
+        access.modified();
     }
-    update();
+    fitView();
+}
+
+
+void GameWidget::jumpGenerations(qulonglong n) {
+    /* advance the Game of Life by n generations at once */
+
+    if (universeMode != 0) return;
 
+    // evolved on the worker thread, like every other generation
+    simulation.jumpGenerations(n);
 }
 
 
@@ -96,10 +128,32 @@ int GameWidget::getUniverseSize() {
 
 
 void GameWidget::setUniverseSize(const int &s) {
-    /* set number of the cells in one row */
-    universeSize = s;
-    ca1.resetWorldSize(s, s);
-    update();
+    /* set number of the cells in one row; keeps the old size if the new one does not fit into memory */
+
+    {
+        Simulation::Access access(simulation);
+        int old = universeSize;
+        universeSize = qMin(s, ca1.getMaxSize(universeMode));
+        try {
+            ca1.resetWorldSize(universeSize, universeSize);
+        } catch (const std::bad_alloc &) {
+            universeSize = old;
+            ca1.resetWorldSize(universeSize, universeSize);
+        }
+        access.modified();
+    }
+    if (universeSize != qMin(s, getMaxUniverseSize())) {
+        QMessageBox::warning(this, tr("Universe Too Large"),
+                             tr("There is not enough memory for %1 x %1 cells.").arg(s), QMessageBox::Ok);
+    }
+    fitView();
+}
+
+
+int GameWidget::getMaxUniverseSize() {
+    /* largest number of cells in one row for the current mode */
+    Simulation::Access access(simulation);
+    return ca1.getMaxSize(universeMode);
 }
 
 
@@ -111,6 +165,12 @@ int GameWidget::getUniverseMode() {
 void GameWidget::setUniverseMode(const int &m) {
     int old_m = GameWidget::getUniverseMode();
     universeMode = m;
+    {
+        Simulation::Access access(simulation);
+        ca1.setUniverseMode(m);
+        access.modified();
+    }
+    updatePalette();
 
     if (old_m != m) GameWidget::clearGame();
     update();
@@ -127,356 +187,231 @@ void GameWidget::setCellMode(const int &m) {
 }
 
 
-CAbase GameWidget::getCA() {
-    return ca1;
+bool GameWidget::loadGame(std::istream &in, GameFile &file) {
+    /* replace the universe by a saved game of the current mode */
+
+    bool ok;
+    {
+        Simulation::Access access(simulation);
+        ok = readGame(in, universeMode, ca1, file);
+        universeSize = ca1.getNx();
+        access.modified();
+    }
+    fitView();
+    return ok;
 }
 
 
-QString GameWidget::dumpGame(char member) {
-    /* dump current universe into a string*/
+void GameWidget::saveGame(std::ostream &out, const GameFile &file) {
+    Simulation::Access access(simulation);
+    writeGame(out, ca1, file);
+}
 
-    char temp;
-    QString master = "";
 
-    switch (universeMode) {
+bool GameWidget::loadPattern(std::istream &in, int format, QString &rule) {
+    /* replace the universe by a Life pattern (RLE or Macrocell), centered; rule is the one of the file */
 
-    // GAME OF LIFE
-    case 0:
-        for (int k = 1; k <= universeSize; k++) {
-            for (int j = 1; j <= universeSize; j++) {
-                if (ca1.getValue(j, k) == 1) {
-                    temp = '*';
-                } else {
-                    temp = 'o';
-                }
-                master.append(temp);
-            }
-            master.append("\n");
-        }
-        return master;
-        break;
+    bool ok;
+    LifeRule r;
+    {
+        Simulation::Access access(simulation);
+        ok = readPattern(in, format, ca1, r);
+        universeSize = ca1.getNx();
+        access.modified();
+    }
+    rule = QString::fromStdString(ruleString(r));
+    fitView();
+    return ok;
+}
 
-    // SNAKE
-    case 1:
-        for (int k = 1; k <= universeSize; k++) {
-            for (int j = 1; j <= universeSize; j++) {
-                int value = ca1.getValue(j, k);
-                if (value == 5) {
-                    temp = 'F';
-                } else if (value == 10) {
-                    temp = 'H';
-                } else if (value > 10) {
-                    temp = 'H' + value - 10;
-                } else {
-                    temp = 'G';
-                }
-                master.append(temp);
-            }
-            master.append("\n");
-        }
-        return master;
-        break;
 
-    // PREDATOR
-    case 2:
-        if (member == 'v') { // world value
-            for (int k = 1; k <= universeSize; k++) {
-                for (int j = 1; j <= universeSize; j++) {
-                    int value = ca1.getValue(j, k);
-                    if (value == 1) {
-                        temp = 'J';
-                    } else if (value == 2) {
-                        temp = 'G';
-                    } else if (value == 5) {
-                        temp = 'F';
-                    } else {
-                        temp = 'o';
-                    }
-                    master.append(temp);
-                }
-                master.append("\n");
-            }
-        } else if (member == 'l') { // lifetime
-            for (int k = 1; k <= universeSize; k++) {
-                for (int j = 1; j <= universeSize; j++) {
-                    int lT = ca1.getLifetime(j, k);
-                    if (lT == 0) {
-                        temp = 'B';
-                    } else if (lT == __INT16_MAX__) {
-                        temp = 'A';
-                    } else if (lT > 0 && lT < __INT16_MAX__) {
-                        temp = 'B' + lT;
-                    }
-                    master.append(temp);
-                }
-                master.append("\n");
-            }
-        }
+void GameWidget::savePattern(std::ostream &out, int format) {
+    Simulation::Access access(simulation);
+    writePattern(out, format, ca1);
+}
 
-        return master;
-        break;
 
-    default:
-        return master;
-        break;
-    }
+bool GameWidget::loadSnapshot(const char *path) {
+    /* replace the universe by a snapshot of the current mode, mapped instead of read */
 
+    bool ok;
+    {
+        Simulation::Access access(simulation);
+        ok = ca1.loadSnapshot(path, universeMode);
+        universeSize = ca1.getNx();
+        access.modified();
+    }
+    fitView();
+    return ok;
 }
 
 
-void GameWidget::reconstructGame(const QString &data, char member) {
-     /* reconstruct game from dump */
-
-    int current;
-    int ascii_H = (int) 'H';
-    int ascii_B = (int) 'B';
-    int ascii_Char;
+bool GameWidget::saveSnapshot(const char *path) {
+    Simulation::Access access(simulation);
+    return ca1.saveSnapshot(path);
+}
 
-    switch (universeMode) {
 
-    // GAME OF LIFE
-    case 0:
-        current = 0;
-        for (int k = 1; k <= universeSize; k++) {
-            for (int j = 1; j <= universeSize; j++) {
-               if (data[current] == '*') {
-                   ca1.setValue(j, k, 1);
-                }
-                current++;
-            }
-            current++;
-        }
-        break;
+int GameWidget::getInterval() {
+    /* return time interval between two consecutive generations [msec]*/
+    return interval;
+}
 
-    // SNAKE
-    case 1:
-        current = 0;
-        for (int k = 1; k <= universeSize; k++) {
-            for (int j = 1; j <= universeSize; j++) {
-                ascii_Char = data[current].unicode();
-                if (data[current] == 'F') {
-                    ca1.setValue(j, k, 5);
-                }
-                else if (ascii_Char >= ascii_H) {
-                    ca1.setValue(j, k, 10 + ascii_Char - ascii_H);
-                } else {
-                    ca1.setValue(j, k, 0);
-                }
-                current++;
-            }
-            current++;
-        }
-        break;
 
-    // PREDATOR
-    case 2:
-        if (member == 'v') {
-            current = 0;
-            for (int k = 1; k <= universeSize; k++) {
-                for (int j = 1; j <= universeSize; j++) {
-                    ascii_Char = data[current].unicode();
-                    if (data[current] == 'F') {
-                        ca1.setValue(j, k, 5);
-                    }
-                    else if (data[current] == 'G') {
-                        ca1.setValue(j, k, 2);
-                    } else if (data[current] == 'J'){
-                        ca1.setValue(j, k, 1);
-                    } else {
-                         ca1.setValue(j, k, 0);
-                    }
-                    current++;
-                }
-                current++;
-            }
-        } else if (member == 'l') {
-            current = 0;
-            for (int k = 1; k <= universeSize; k++) {
-                for (int j = 1; j <= universeSize; j++) {
-                    ascii_Char = data[current].unicode();
-                    if (data[current] == 'A') {
-                        ca1.setLifetime(j, k, __INT16_MAX__);
-                    }
-                    else if (data[current] == 'B') {
-                        ca1.setLifetime(j, k, 0);
-                    } else if (ascii_Char > ascii_B){
-                        ca1.setLifetime(j, k, ascii_Char - ascii_B);
-                    }
-                    current++;
-                }
-                current++;
-            }
-        }
+void GameWidget::setInterval(int msec) {
+    /* set interval between generations */
+    interval = msec;
+    if (!turbo) simulation.setInterval(msec);
+}
 
-        break;
 
-    default:
-        break;
-    }
-
-    update();
+bool GameWidget::getTurbo() {
+    return turbo;
 }
 
 
-int GameWidget::getInterval() {
-    /* return time interval between two consecutive generations [msec]*/
-    return timer->interval();
+void GameWidget::setTurbo(bool t) {
+    /* evolve as fast as the core allows instead of one generation per interval; frames are still
+     * painted at the display rate, with as many generations in between as fit */
+
+    turbo = t;
+    simulation.setInterval(t ? 0 : interval);
 }
 
 
-void GameWidget::setInterval(int msec) {
-    /* set interval between generations */
-    timer->setInterval(msec);
+void GameWidget::measureRate() {
+    /* report the generations per second since the last report */
+
+    quint64 evolved = simulation.getEvolved();
+    qint64 msec = rateClock.restart();
+    if (msec > 0) emit generationRate((evolved - rateEvolved) * 1000.0 / msec);
+    rateEvolved = evolved;
 }
 
 
-void GameWidget::newGeneration() {
-    /* start the evolution of universe and update the game field */
+void GameWidget::evolutionHalted(int reason, qulonglong period, qulonglong start) {
+    /* the worker stopped the evolution: tell why */
 
-    if (generations < 0)
-        generations++;
+    stopGame();
+    gameEnds(universeMode, true);
 
-    switch (universeMode) {
-    // game of life
-    case 0:
-        ca1.worldEvolutionLife();
-        break;
-    // snake
-    case 1:
-        ca1.worldEvolutionSnake();
-        break;
-    // predator-prey
-    case 2:
-        //ca1.worldEvolutionLife();
-        //qDebug() << "newGeneration -> worldEvolutionPredator()";
-        ca1.worldEvolutionPredator();
-        break;
-    // noise
-    case 3:
-        ca1.worldEvolutionNoise();
-        break;
-    // erosion
-    case 4:
-        ca1.worldEvolutionErosion();
+    switch (reason) {
+    case Simulation::HaltNoChanges:
+        if (universeMode == 1) {
+            QMessageBox::information(this, tr("Game over!"), tr("Your snake hit an obstacle."), QMessageBox::Ok);
+        } else {
+            QMessageBox::information(this, tr("Evolution stopped!"),
+                                     tr("All future generations will be identical to this one."), QMessageBox::Ok);
+        }
         break;
-    // fluids
-    case 5:
-        ca1.worldEvolutionFluids();
+    case Simulation::HaltPeriodic:
+        QMessageBox::information(this, tr("Evolution is periodic!"),
+                                 tr("Periodic with period %1 since generation %2.").arg(period).arg(start),
+                                 QMessageBox::Ok);
         break;
-    // gases
-    case 6:
-        ca1.worldEvolutionGases();
+    case Simulation::HaltFinished:
+        QMessageBox::information(this, tr("Game finished."), tr("Iterations finished."),
+                                 QMessageBox::Ok, QMessageBox::Cancel);
         break;
-
     default:
         break;
     }
+}
 
-    update();
 
-    if (ca1.isNotChanged()) {
-        const QString headlines[] = {"Evolution stopped!", "Game over!"};
-        const QString details[] = {"All future generations will be identical to this one.",
-                                   "Your snake hit an obstacle."};
-
-        QMessageBox msgBox;
-        switch (universeMode) {
-        // game of life
-        case 0:
-            msgBox.setIcon(QMessageBox::Information);
-            msgBox.setText(headlines[0]);
-            msgBox.setInformativeText(details[0]);
-            break;
-        // snake
-        case 1:
-            msgBox.setIcon(QMessageBox::Information);
-            msgBox.setText(headlines[1]);
-            msgBox.setInformativeText(details[1]);
-            break;
-        // predator-prey
-        case 2:
-            msgBox.setIcon(QMessageBox::Information);
-            msgBox.setText(headlines[0]);
-            msgBox.setInformativeText(details[0]);
-            break;
-        // noise
-        case 3:
-            msgBox.setIcon(QMessageBox::Information);
-            msgBox.setText(headlines[0]);
-            msgBox.setInformativeText(details[0]);
-            break;
-        // erosion
-        case 4:
-            msgBox.setIcon(QMessageBox::Information);
-            msgBox.setText(headlines[0]);
-            msgBox.setInformativeText(details[0]);
-            break;
-        // fluids
-        case 5:
-            msgBox.setIcon(QMessageBox::Information);
-            msgBox.setText(headlines[0]);
-            msgBox.setInformativeText(details[0]);
-            break;
-        // gases
-        case 6:
-            msgBox.setIcon(QMessageBox::Information);
-            msgBox.setText(headlines[0]);
-            msgBox.setInformativeText(details[0]);
-            break;
+void GameWidget::paintEvent(QPaintEvent *) {
+    /* paint the grid and the universe inside ui */
 
-        default:
-            break;
-        }
-        msgBox.exec();
-        stopGame();
-        gameEnds(universeMode, true);
-        return;
-    }
+    QPainter p(this);
+    paintGrid(p);
+    paintUniverse(p);
+}
 
-    generations--;
-    if (generations == 0) {
-        stopGame();
-        gameEnds(universeMode, true);
-        QMessageBox::information(this, tr("Game finished."), tr("Iterations finished."),
-                                 QMessageBox::Ok, QMessageBox::Cancel);
+
+void GameWidget::resizeEvent(QResizeEvent *) {
+    /* the worker renders for the size of the widget */
+
+    if (viewFitted) {
+        fitView();
+    } else {
+        clampView();
+        viewChanged();
     }
+}
+
+
+void GameWidget::wheelEvent(QWheelEvent *e) {
+    /* zoom in or out around the cell under the mouse, down to the whole universe */
 
+    double fit = qMin(width(), height()) / (double) universeSize;
+    double z = zoom * qPow(1.25, e->angleDelta().y() / 120.0);
+    z = qBound(fit, z, (double) maxZoom);
+    // the cell under the mouse stays where it is
+    QPointF mouse = e->position();
+    double cx = viewX + mouse.x() / zoom;
+    double cy = viewY + mouse.y() / zoom;
+    zoom = z;
+    viewX = cx - mouse.x() / zoom;
+    viewY = cy - mouse.y() / zoom;
+    viewFitted = (z <= fit);
+    clampView();
+    viewChanged();
+    e->accept();
 }
 
 
-void GameWidget::newGenerationColor() {
-    /* start the evolution of universe and update the game field for "Cyclic cellular automata" mode */
+void GameWidget::fitView() {
+    /* show the whole universe */
 
-    if (generations < 0)
-        generations++;
+    zoom = qMin(width(), height()) / (double) universeSize;
+    if (zoom <= 0) zoom = 1;
+    viewFitted = true;
+    clampView();
+    viewChanged();
+}
 
-    update();
 
-    generations--;
-    if (generations == 0) {
-        stopGame();
-        gameEnds(universeMode, true);
-        QMessageBox::information(this, tr("Game finished."), tr("Iterations finished."),
-                                 QMessageBox::Ok, QMessageBox::Cancel);
-    }
+void GameWidget::clampView() {
+    /* keep the universe in view: centered if it is smaller than the widget, filling it otherwise */
+
+    double visibleX = width() / zoom, visibleY = height() / zoom;
+    if (visibleX >= universeSize) viewX = (universeSize - visibleX) / 2;
+    else viewX = qBound(0.0, viewX, universeSize - visibleX);
+    if (visibleY >= universeSize) viewY = (universeSize - visibleY) / 2;
+    else viewY = qBound(0.0, viewY, universeSize - visibleY);
 }
 
 
-void GameWidget::paintEvent(QPaintEvent *) {
-    /* paint the grid and the universe inside ui */
+void GameWidget::viewChanged() {
+    /* the worker renders the new viewport, the grid is redrawn */
 
-    QPainter p(this);
-    paintGrid(p);
-    paintUniverse(p);
+    gridCache = QPixmap();
+    simulation.setViewport(viewX, viewY, zoom, width(), height());
+    update();
+}
+
+
+bool GameWidget::cellAt(const QPoint &pos, int &j, int &k) {
+    /* cell under a position of the widget; false outside of the universe */
+
+    j = (int) floor(viewX + pos.x() / zoom) + 1;
+    k = (int) floor(viewY + pos.y() / zoom) + 1;
+    return j >= 1 && j <= universeSize && k >= 1 && k <= universeSize;
 }
 
 
 void GameWidget::mousePressEvent(QMouseEvent *e) {
+    /* left button: edit the cell under the mouse; right or middle button: drag the view */
+
+    if (e->button() != Qt::LeftButton) {
+        panPosition = e->pos();
+        return;
+    }
+    int j, k;
+    if (!cellAt(e->pos(), j, k)) return;
+
     emit universeModified(universeMode, true);
-    double cellWidth = (double) width() / universeSize;
-    double cellHeight = (double) height() / universeSize;
-    int k = floor(e->y() / cellHeight) + 1;
-    int j = floor(e->x() / cellWidth) + 1;
+    Simulation::Access access(simulation);
 
     // int mode[9] = {1, 3, 6, 4, 2, 8, 9, 10, 11};
 
@@ -488,7 +423,7 @@ void GameWidget::mousePressEvent(QMouseEvent *e) {
         else {
             ca1.setValue(j, k, 1);
         }
-        update();
+        access.modified();
     }
 
     // predator-prey
@@ -524,16 +459,26 @@ void GameWidget::mousePressEvent(QMouseEvent *e) {
         default:
             break;
         }
-        update();
+        access.modified();
     }
 }
 
 
 void GameWidget::mouseMoveEvent(QMouseEvent *e) {
-    double cellWidth = (double) width() / universeSize;
-    double cellHeight = (double) height() / universeSize;
-    int k = floor(e->y() / cellHeight) + 1;
-    int j = floor(e->x() / cellWidth) + 1;
+    if (e->buttons() & (Qt::RightButton | Qt::MiddleButton)) {
+        // drag the view
+        viewX -= (e->pos().x() - panPosition.x()) / zoom;
+        viewY -= (e->pos().y() - panPosition.y()) / zoom;
+        panPosition = e->pos();
+        viewFitted = false;
+        clampView();
+        viewChanged();
+        return;
+    }
+    int j, k;
+    if (!cellAt(e->pos(), j, k)) return;
+
+    Simulation::Access access(simulation);
 
     // int mode[9] = {1, 3, 6, 4, 2, 8, 9, 10, 11};
 
@@ -541,7 +486,7 @@ void GameWidget::mouseMoveEvent(QMouseEvent *e) {
     if (universeMode != 2 && universeMode != 1) {
         if (ca1.getValue(j, k) == 0) {
             ca1.setValue(j, k, 1);
-            update();
+            access.modified();
         }
     }
     // predator-prey
@@ -568,59 +513,71 @@ void GameWidget::mouseMoveEvent(QMouseEvent *e) {
         default:
             break;
         }
-        update();
+        access.modified();
     }
 }
 
 
 void GameWidget::paintGrid(QPainter &p) {
-    /* paint the grid in the ui */
-
-    QRect borders(0, 0, width() - 1, height() - 1); // borders of the universe
-    QColor gridColor = masterColor; // color of the grid
-    gridColor.setAlpha(10); // must be lighter than main color
-    p.setPen(gridColor);
-    double cellWidth = (double) width() / universeSize; // width of the widget / number of cells at one row
-    for (double k = cellWidth; k <= width(); k += cellWidth)
-        p.drawLine(k, 0, k, height());
-    double cellHeight = (double) height() / universeSize; // height of the widget / number of cells at one row
-    for (double k = cellHeight; k <= height(); k += cellHeight)
-        p.drawLine(0, k, width(), k);
-    p.drawRect(borders);
+    /* paint the grid in the ui
+     *
+     * The grid of the visible cells is drawn once into a cached pixmap, which is redrawn only when
+     * the view, the widget, the universe size or the master color changes. Lines closer than
+     * minGridSpacing pixels would only smear into a gray area, so then just the borders are drawn.
+     */
+
+    if (gridCache.size() != size()) {
+        gridCache = QPixmap(size());
+        gridCache.fill(Qt::transparent);
+
+        QPainter g(&gridCache);
+        QRectF borders(-viewX * zoom, -viewY * zoom, universeSize * zoom - 1, universeSize * zoom - 1); // borders of the universe
+        QColor gridColor = masterColor; // color of the grid
+        gridColor.setAlpha(10); // must be lighter than main color
+        g.setPen(gridColor);
+        if (zoom >= minGridSpacing) {
+            // cell boundaries inside the widget, from the first visible one
+            double top = qMax(borders.top(), 0.0), bottom = qMin(borders.bottom(), (double) height());
+            for (int c = qMax(1, (int) ceil(viewX)); c < universeSize && (c - viewX) * zoom <= width(); c++)
+                g.drawLine(QPointF((c - viewX) * zoom, top), QPointF((c - viewX) * zoom, bottom));
+            double left = qMax(borders.left(), 0.0), right = qMin(borders.right(), (double) width());
+            for (int c = qMax(1, (int) ceil(viewY)); c < universeSize && (c - viewY) * zoom <= height(); c++)
+                g.drawLine(QPointF(left, (c - viewY) * zoom), QPointF(right, (c - viewY) * zoom));
+        }
+        g.drawRect(borders);
+    }
+    p.drawPixmap(0, 0, gridCache);
 }
 
 
 void GameWidget::paintUniverse(QPainter &p) {
-    /* paint cell values with specific colors into grid */
-
-    double cellWidth = (double) width() / universeSize;
-    double cellHeight = (double) height() / universeSize;
-    for (int k = 1; k <= universeSize; k++) {
-        for (int j = 1; j <= universeSize; j++) {
-            if (ca1.getValue(j, k) != 0) {
-                qreal left = (qreal) (cellWidth * j - cellWidth); // margin from left
-                qreal top  = (qreal) (cellHeight * k - cellHeight); // margin from top
-                QRectF r(left, top, (qreal) cellWidth, (qreal) cellHeight);
-                // p.fillRect(r, QBrush(masterColor));
-                if (universeMode != 2) {
-                    p.fillRect(r, QBrush(masterColor));
-                } else {
-                    p.fillRect(r, getPredefinedColor(ca1.getValue(j, k))); //fill cell with brush of cell type
-                }
-
-//                if (0 && universeMode != 7) { // randomMode = 0
-//                    p.fillRect(r, setColor(ca1.getColor(j, k))); //fill cell with brush from random mode
-//                 }
-//                else {
-//                    if (ca1.getValue(j, k) == 1 || universeMode == 7) {
-//                        p.fillRect(r, QBrush(masterColor)); // fill cell with brush of main color
-//                    }
-//                    else {
-//                        p.fillRect(r, setColor(ca1.getValue(j, k))); //fill cell with brush of cell type
-//                    }
-//                }
-            }
-        }
+    /* paint the newest generation the worker finished, scaled onto its cells with one drawImage
+     *
+     * Its pixels are cell values, or the share of occupied cells if a cell is smaller than a pixel;
+     * the palette gives them their colors. The frame only covers the cells that were visible when
+     * it was rendered, and is placed by the current view, so that dragging the view never waits for
+     * the worker.
+     */
+
+    simulation.takeFrame();
+    SimulationFrame &f = simulation.frame();
+    if (f.image.isNull()) return;
+    f.image.setColorTable(f.density ? densityPalette : palette);
+    QRectF target((f.cells.x() - viewX) * zoom, (f.cells.y() - viewY) * zoom,
+                  f.cells.width() * zoom, f.cells.height() * zoom);
+    p.drawImage(target, f.image);
+}
+
+
+void GameWidget::updatePalette() {
+    /* colors of all cell values: the master color, or the predefined colors for predator-prey;
+     * the density levels are the master color with growing opacity */
+
+    palette.fill(qRgba(0, 0, 0, 0), 256);
+    densityPalette.fill(qRgba(0, 0, 0, 0), 256);
+    for (int i = 1; i < 256; i++) {
+        palette[i] = (universeMode == 2 && i < 12) ? getPredefinedColor(i).rgb() : masterColor.rgb();
+        densityPalette[i] = qRgba(masterColor.red(), masterColor.green(), masterColor.blue(), i);
     }
 }
 
@@ -632,6 +589,8 @@ QColor GameWidget::getMasterColor() {
 
 void GameWidget::setMasterColor(const QColor &color) {
     masterColor = color;
+    updatePalette();
+    gridCache = QPixmap(); // the grid takes its color from the master color
     update();
 }
 
@@ -640,6 +599,7 @@ void GameWidget::setMasterColor(const QColor &color) {
 void GameWidget::calcDirectionSnake(int dS) {
     /* opposing directions add up to 10 (2 + 8, 4 + 6), so past and future must NOT do so */
 
+    Simulation::Access access(simulation);
     if (dS + ca1.directionSnake.past == 10) {
         ca1.directionSnake.future = ca1.directionSnake.past; // continue with past direction if input is "invalid"
     } else {
@@ -649,28 +609,33 @@ void GameWidget::calcDirectionSnake(int dS) {
 
 
 void GameWidget::setDirectionSnake(int past, int future) {
+    Simulation::Access access(simulation);
     ca1.directionSnake.past = past;
     ca1.directionSnake.future = future;
 }
 
 
 void GameWidget::setSnakeLength(int l) {
+    Simulation::Access access(simulation);
     ca1.setSnakeLength(l);
 }
 
 
 void GameWidget::setSnakeAction(int a) {
+    Simulation::Access access(simulation);
     ca1.setSnakeAction(a);
 }
 
 
 void GameWidget::setPositionSnakeHead(int x, int y) {
+    Simulation::Access access(simulation);
     ca1.positionSnakeHead.x = x;
     ca1.positionSnakeHead.y = y;
 }
 
 
 void GameWidget::setPositionFood(int x, int y) {
+    Simulation::Access access(simulation);
     ca1.positionFood.x = x;
     ca1.positionFood.y = y;
 }
@@ -686,19 +651,75 @@ void GameWidget::setLifetime(const int &l) {
 }
 
 
+int GameWidget::getThreadCount() {
+    Simulation::Access access(simulation);
+    return ca1.getThreadCount();
+}
+
+
+void GameWidget::setThreadCount(int n) {
+    /* worker threads for every mode but Snake */
+    Simulation::Access access(simulation);
+    ca1.setThreadCount(n);
+}
+
+
+qulonglong GameWidget::getSeed() {
+    Simulation::Access access(simulation);
+    return ca1.getSeed();
+}
+
+
+void GameWidget::setSeed(qulonglong s) {
+    /* seed of the random numbers of Snake, Predator and Gases */
+    Simulation::Access access(simulation);
+    ca1.setSeed(s);
+}
+
+
+qulonglong GameWidget::getGeneration() {
+    Simulation::Access access(simulation);
+    return ca1.getGeneration();
+}
+
+
+void GameWidget::setGeneration(qulonglong g) {
+    /* generation a loaded game continues from, so that it draws the same random numbers as the saved one */
+    Simulation::Access access(simulation);
+    ca1.setGeneration(g);
+}
+
+
+QString GameWidget::getRule() {
+    Simulation::Access access(simulation);
+    return QString::fromStdString(ruleString(ca1.getRule()));
+}
+
+
+bool GameWidget::setRule(const QString &r) {
+    /* rule of the custom rule mode in B/S notation, e.g. "B36/S23"; returns false if it is malformed */
+
+    LifeRule rule;
+    if (!parseRule(r.trimmed().toStdString(), rule)) return false;
+    Simulation::Access access(simulation);
+    ca1.setRule(rule);
+    return true;
+}
+
+
 QColor GameWidget::getPredefinedColor(const int &color) {
-    QColor cellColor[12]= {Qt::red,
-                           Qt::darkRed,
-                           Qt::green,
-                           Qt::darkGreen,
-                           Qt::blue,
-                           Qt::darkBlue,
-                           Qt::cyan,
-                           Qt::darkCyan,
-                           Qt::magenta,
-                           Qt::darkMagenta,
-                           Qt::yellow,
-                           Qt::darkYellow};
+    static const QColor cellColor[12]= {Qt::red,
+                                        Qt::darkRed,
+                                        Qt::green,
+                                        Qt::darkGreen,
+                                        Qt::blue,
+                                        Qt::darkBlue,
+                                        Qt::cyan,
+                                        Qt::darkCyan,
+                                        Qt::magenta,
+                                        Qt::darkMagenta,
+                                        Qt::yellow,
+                                        Qt::darkYellow};
 
     return cellColor[color];
 }
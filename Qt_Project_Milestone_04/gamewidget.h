@@ -2,9 +2,14 @@
 #define GAMEWIDGET_H
 
 #include <QColor>
+#include <QElapsedTimer>
+#include <QPixmap>
+#include <QVector>
 #include <QWidget>
 #include <QObject>
 #include "CAbase.h"
+#include "gameio.h"
+#include "simulation.h"
 
 
 class GameWidget : public QWidget {
@@ -14,10 +19,11 @@ class GameWidget : public QWidget {
 public:
     explicit GameWidget(QWidget *parent = 0);
     ~GameWidget();
-    CAbase getCA();
 
 protected:
     void paintEvent(QPaintEvent *);
+    void resizeEvent(QResizeEvent *);
+    void wheelEvent(QWheelEvent *e);
     void mousePressEvent(QMouseEvent *e);
     void mouseMoveEvent(QMouseEvent *e);
 
@@ -26,15 +32,20 @@ signals:
     void gameStarted(int, bool);
     void gameStopped(int, bool);
     void gameEnds(int, bool);
+    void generationRate(double);
 
 
 public slots:
     void startGame(const int &number = -1);
     void stopGame();
     void clearGame();
+    void jumpGenerations(qulonglong n);
 
     int getUniverseSize();
     void setUniverseSize(const int &s);
+    int getMaxUniverseSize();
+
+    void fitView();
 
     int getUniverseMode();
     void setUniverseMode(const int &m);
@@ -45,16 +56,35 @@ public slots:
     int getInterval();
     void setInterval(int msec);
 
+    bool getTurbo();
+    void setTurbo(bool t);
+
     int getLifetime();
     void setLifetime(const int &l);
 
+    int getThreadCount();
+    void setThreadCount(int n);
+
+    qulonglong getSeed();
+    void setSeed(qulonglong s);
+
+    qulonglong getGeneration();
+    void setGeneration(qulonglong g);
+
+    QString getRule();
+    bool setRule(const QString &r);
+
     QColor getMasterColor();
     void setMasterColor(const QColor &color);
 
     QColor getPredefinedColor(const int &color);
 
-    QString dumpGame(char member = 'v');
-    void reconstructGame(const QString &data, char member = 'v');
+    bool loadGame(std::istream &in, GameFile &file);
+    void saveGame(std::ostream &out, const GameFile &file);
+    bool loadPattern(std::istream &in, int format, QString &rule);
+    void savePattern(std::ostream &out, int format);
+    bool loadSnapshot(const char *path);
+    bool saveSnapshot(const char *path);
 
     // SNAKE
     void calcDirectionSnake (int dS);
@@ -73,19 +103,37 @@ public slots:
 private slots:
     void paintGrid(QPainter &p);
     void paintUniverse(QPainter &p);
-    void newGeneration();
-    void newGenerationColor();
+    void updatePalette();
+    bool cellAt(const QPoint &pos, int &j, int &k);
+    void clampView();
+    void viewChanged();
+    void evolutionHalted(int reason, qulonglong period, qulonglong start);
+    void measureRate();
 
 private:
     QColor masterColor;
-    QTimer *timer;
-    QTimer *timerColor;
+    QVector<QRgb> palette;         // color of every cell value
+    QVector<QRgb> densityPalette;  // color of every share of occupied cells, 0 .. 255
+    QPixmap gridCache;             // grid lines of the current view
+    QTimer *timerRate;             // reports the generations per second while the game runs
+    QElapsedTimer rateClock;
+    quint64 rateEvolved;           // generations the worker had evolved at the last report
     CAbase ca1;
+    Simulation simulation;         // evolves ca1 on its own thread; stops before ca1 is destroyed
     int universeSize;
     int universeMode;
     int cellMode;
     int lifeTime;
-    int generations;
+    int interval;                  // msec between two generations, unless turbo
+    bool turbo;                    // evolve as fast as possible
+    // VIEWPORT
+    double viewX;                  // cell coordinate (from 0) of the left edge of the widget
+    double viewY;                  // cell coordinate of the top edge
+    double zoom;                   // pixels per cell
+    bool viewFitted;               // the whole universe is shown, also after resizing
+    QPoint panPosition;            // last mouse position while dragging the view
+    static const int minGridSpacing = 3; // pixels between grid lines, below which they are left out
+    static const int maxZoom = 64;       // pixels per cell at most
     // int randomMode;
 
 };
@@ -0,0 +1,317 @@
+#include "hashlife.h"
+
+const uint32_t HashLife::none;
+
+
+static inline uint64_t hashNode(uint32_t nw, uint32_t ne, uint32_t sw, uint32_t se) {
+    uint64_t h = nw * 0x9E3779B97F4A7C15ULL ^ ne * 0xC2B2AE3D27D4EB4FULL ^
+                 sw * 0x165667B19E3779F9ULL ^ se * 0x27D4EB2F165667C5ULL;
+    return h ^ (h >> 29);
+}
+
+
+HashLife::HashLife() :
+    stepLog(0),
+    maxNodes(size_t(1) << 22),
+    lastRoot(none)
+{
+    clear();
+}
+
+
+void HashLife::clear() {
+    /* drop all nodes but the two leaves */
+
+    Node dead = {none, none, none, none, none, none, 0, 0};
+    Node alive = dead;
+    nodes.assign(1, dead);
+    nodes.push_back(alive);
+    empty.clear();
+    lastRoot = none;
+    stepLog = 0;
+    rehash(size_t(1) << 16);
+}
+
+
+void HashLife::rehash(size_t size) {
+    /* rebuild the hash chains for a table of size buckets (a power of two) */
+
+    buckets.assign(size, none);
+    for (size_t i = 2; i < nodes.size(); i++) {
+        Node &n = nodes[i];
+        size_t h = hashNode(n.nw, n.ne, n.sw, n.se) & (size - 1);
+        n.next = buckets[h];
+        buckets[h] = (uint32_t) i;
+    }
+}
+
+
+uint32_t HashLife::join(uint32_t nw, uint32_t ne, uint32_t sw, uint32_t se) {
+    /* canonical node with the given children */
+
+    size_t h = hashNode(nw, ne, sw, se) & (buckets.size() - 1);
+    for (uint32_t i = buckets[h]; i != none; i = nodes[i].next) {
+        const Node &n = nodes[i];
+        if (n.nw == nw && n.ne == ne && n.sw == sw && n.se == se) return i;
+    }
+
+    Node n = {nw, ne, sw, se, none, buckets[h], uint8_t(nodes[nw].level + 1), 0};
+    uint32_t i = (uint32_t) nodes.size();
+    nodes.push_back(n);
+    buckets[h] = i;
+    if (nodes.size() > buckets.size()) rehash(2 * buckets.size());
+    return i;
+}
+
+
+uint32_t HashLife::emptyNode(int level) {
+    /* canonical dead node of the given level */
+
+    if ((int) empty.size() <= level) empty.resize(level + 1, none);
+    if (empty[level] == none) {
+        uint32_t e = (level == 0) ? 0 : emptyNode(level - 1);
+        empty[level] = (level == 0) ? 0 : join(e, e, e, e);
+    }
+    return empty[level];
+}
+
+
+uint32_t HashLife::centre(uint32_t n) {
+    /* centre of node n (one level below), not advanced in time */
+
+    Node c = nodes[n];
+    return join(nodes[c.nw].se, nodes[c.ne].sw, nodes[c.sw].ne, nodes[c.se].nw);
+}
+
+
+uint32_t HashLife::resultLevel2(uint32_t n) {
+    /* centre 2x2 of a 4x4 node after one generation */
+
+    int cell[4][4];
+    Node c = nodes[n];
+    uint32_t quadrants[4] = {c.nw, c.ne, c.sw, c.se};
+    for (int q = 0; q < 4; q++) {
+        const Node &s = nodes[quadrants[q]];
+        int x0 = 2 * (q & 1), y0 = 2 * (q >> 1);
+        cell[y0][x0] = s.nw;
+        cell[y0][x0 + 1] = s.ne;
+        cell[y0 + 1][x0] = s.sw;
+        cell[y0 + 1][x0 + 1] = s.se;
+    }
+
+    uint32_t next[4];
+    for (int y = 1; y <= 2; y++) {
+        for (int x = 1; x <= 2; x++) {
+            int n_sum = cell[y - 1][x - 1] + cell[y - 1][x] + cell[y - 1][x + 1] +
+                        cell[y][x - 1]                      + cell[y][x + 1] +
+                        cell[y + 1][x - 1] + cell[y + 1][x] + cell[y + 1][x + 1];
+            next[2 * (y - 1) + (x - 1)] = (n_sum == 3 || (n_sum == 2 && cell[y][x] == 1)) ? 1 : 0;
+        }
+    }
+    return join(next[0], next[1], next[2], next[3]);
+}
+
+
+uint32_t HashLife::result(uint32_t n) {
+    /* centre of node n (one level below) after min(2^stepLog, 2^(level - 2)) generations */
+
+    if (nodes[n].result != none) return nodes[n].result;
+
+    int level = nodes[n].level;
+    uint32_t r;
+    if (n == emptyNode(level)) {
+        r = emptyNode(level - 1);
+    } else if (level == 2) {
+        r = resultLevel2(n);
+    } else {
+        Node c = nodes[n];
+        Node nw = nodes[c.nw], ne = nodes[c.ne], sw = nodes[c.sw], se = nodes[c.se];
+
+        // nine overlapping subnodes one level below
+        uint32_t n00 = c.nw;
+        uint32_t n01 = join(nw.ne, ne.nw, nw.se, ne.sw);
+        uint32_t n02 = c.ne;
+        uint32_t n10 = join(nw.sw, nw.se, sw.nw, sw.ne);
+        uint32_t n11 = join(nw.se, ne.sw, sw.ne, se.nw);
+        uint32_t n12 = join(ne.sw, ne.se, se.nw, se.ne);
+        uint32_t n20 = c.sw;
+        uint32_t n21 = join(sw.ne, se.nw, sw.se, se.sw);
+        uint32_t n22 = c.se;
+
+        // at full speed both halves advance in time, otherwise only the second one does
+        bool full = (stepLog >= level - 2);
+        uint32_t r00 = full ? result(n00) : centre(n00);
+        uint32_t r01 = full ? result(n01) : centre(n01);
+        uint32_t r02 = full ? result(n02) : centre(n02);
+        uint32_t r10 = full ? result(n10) : centre(n10);
+        uint32_t r11 = full ? result(n11) : centre(n11);
+        uint32_t r12 = full ? result(n12) : centre(n12);
+        uint32_t r20 = full ? result(n20) : centre(n20);
+        uint32_t r21 = full ? result(n21) : centre(n21);
+        uint32_t r22 = full ? result(n22) : centre(n22);
+
+        uint32_t q0 = result(join(r00, r01, r10, r11));
+        uint32_t q1 = result(join(r01, r02, r11, r12));
+        uint32_t q2 = result(join(r10, r11, r20, r21));
+        uint32_t q3 = result(join(r11, r12, r21, r22));
+        r = join(q0, q1, q2, q3);
+    }
+    nodes[n].result = r;
+    return r;
+}
+
+
+void HashLife::setStepLog(int j) {
+    /* cache results for 2^j generations; nodes small enough to run at full speed keep theirs */
+
+    if (j == stepLog) return;
+    int keep = ((j < stepLog) ? j : stepLog) + 2;
+    for (size_t i = 2; i < nodes.size(); i++) {
+        if (nodes[i].level > keep) nodes[i].result = none;
+    }
+    stepLog = j;
+}
+
+
+void HashLife::collect() {
+    /* mark the nodes reachable from the last universe and compact the store */
+
+    std::vector<uint32_t> stack;
+    nodes[0].mark = nodes[1].mark = 1;
+    if (lastRoot != none) stack.push_back(lastRoot);
+    while (!stack.empty()) {
+        uint32_t i = stack.back();
+        stack.pop_back();
+        if (nodes[i].mark) continue;
+        nodes[i].mark = 1;
+        stack.push_back(nodes[i].nw);
+        stack.push_back(nodes[i].ne);
+        stack.push_back(nodes[i].sw);
+        stack.push_back(nodes[i].se);
+    }
+
+    // children are always created before their parents, so compaction keeps that order
+    std::vector<uint32_t> newIndex(nodes.size(), none);
+    size_t k = 0;
+    for (size_t i = 0; i < nodes.size(); i++) {
+        if (!nodes[i].mark) continue;
+        newIndex[i] = (uint32_t) k;
+        nodes[k++] = nodes[i];
+    }
+    nodes.resize(k);
+    for (size_t i = 0; i < nodes.size(); i++) {
+        Node &n = nodes[i];
+        n.mark = 0;
+        if (i < 2) continue;
+        n.nw = newIndex[n.nw];
+        n.ne = newIndex[n.ne];
+        n.sw = newIndex[n.sw];
+        n.se = newIndex[n.se];
+        // cached results survive if their node did
+        if (n.result != none) n.result = newIndex[n.result];
+    }
+    for (size_t l = 0; l < empty.size(); l++) {
+        if (empty[l] != none) empty[l] = newIndex[empty[l]];
+    }
+    if (lastRoot != none) lastRoot = newIndex[lastRoot];
+    rehash(buckets.size());
+
+    // too much is still reachable: start over
+    if (nodes.size() > maxNodes / 2) clear();
+}
+
+
+uint32_t HashLife::build(const CAview &v, int level, uint64_t xo, uint64_t yo,
+                         const std::vector<uint64_t> &sideX, const std::vector<uint64_t> &sideY,
+                         std::unordered_map<uint64_t, uint32_t> &memo) {
+    /* node of the periodically tiled torus whose top left cell is torus cell xo, yo (0-based) */
+
+    if (level == 0) return v.getValue(int(xo) + 1, int(yo) + 1) == 1 ? 1 : 0;
+
+    // a tile only depends on its level and its offset on the torus
+    uint64_t key = (uint64_t(level) << 48) | (xo << 24) | yo;
+    if (level >= memoLevel) {
+        std::unordered_map<uint64_t, uint32_t>::const_iterator it = memo.find(key);
+        if (it != memo.end()) return it->second;
+    }
+
+    uint64_t xe = (xo + sideX[level - 1]) % v.getNx();
+    uint64_t ys = (yo + sideY[level - 1]) % v.getNy();
+    uint32_t nw = build(v, level - 1, xo, yo, sideX, sideY, memo);
+    uint32_t ne = build(v, level - 1, xe, yo, sideX, sideY, memo);
+    uint32_t sw = build(v, level - 1, xo, ys, sideX, sideY, memo);
+    uint32_t se = build(v, level - 1, xe, ys, sideX, sideY, memo);
+    uint32_t n = join(nw, ne, sw, se);
+
+    if (level >= memoLevel) memo[key] = n;
+    return n;
+}
+
+
+void HashLife::extract(CAbase &ca, uint32_t n, int level, uint64_t x0, uint64_t y0, uint64_t shiftX, uint64_t shiftY) {
+    /* write the living cells of node n at x0, y0 that fall into the first period back onto the torus */
+
+    uint64_t nx = ca.getNx(), ny = ca.getNy();
+    if (x0 >= nx || y0 >= ny) return;
+    if (n == emptyNode(level)) return;
+    if (level == 0) {
+        ca.setValue(int((x0 + shiftX) % nx) + 1, int((y0 + shiftY) % ny) + 1, 1);
+        return;
+    }
+
+    uint64_t half = uint64_t(1) << (level - 1);
+    Node c = nodes[n];
+    extract(ca, c.nw, level - 1, x0, y0, shiftX, shiftY);
+    extract(ca, c.ne, level - 1, x0 + half, y0, shiftX, shiftY);
+    extract(ca, c.sw, level - 1, x0, y0 + half, shiftX, shiftY);
+    extract(ca, c.se, level - 1, x0 + half, y0 + half, shiftX, shiftY);
+}
+
+
+void HashLife::step(CAbase &ca, int k) {
+    /* advance the torus by 2^k generations */
+
+    int nx = ca.getNx(), ny = ca.getNy();
+
+    // the centre of the root (half its side) must cover one period and may advance 2^(level - 2) generations
+    int level = 2;
+    while ((uint64_t(1) << (level - 1)) < uint64_t(nx > ny ? nx : ny)) level++;
+    if (level < k + 2) level = k + 2;
+
+    if (nodes.size() > maxNodes) collect();
+    setStepLog(k);
+
+    // side lengths 2^l modulo the torus size
+    std::vector<uint64_t> sideX(level + 1), sideY(level + 1);
+    sideX[0] = 1 % nx;
+    sideY[0] = 1 % ny;
+    for (int l = 1; l <= level; l++) {
+        sideX[l] = (2 * sideX[l - 1]) % nx;
+        sideY[l] = (2 * sideY[l - 1]) % ny;
+    }
+
+    // the root spans -2^(level - 1) .. 2^(level - 1) around torus cell 0, 0
+    std::unordered_map<uint64_t, uint32_t> memo;
+    uint32_t root = build(ca.view(), level, (nx - sideX[level - 1]) % nx, (ny - sideY[level - 1]) % ny,
+                          sideX, sideY, memo);
+    uint32_t next = result(root);
+    lastRoot = root;
+
+    // the result spans -2^(level - 2) .. 2^(level - 2)
+    for (int y = 1; y <= ny; y++) {
+        for (int x = 1; x <= nx; x++) {
+            ca.setValue(x, y, 0);
+        }
+    }
+    extract(ca, next, level - 1, 0, 0, (nx - sideX[level - 2]) % nx, (ny - sideY[level - 2]) % ny);
+}
+
+
+void HashLife::jump(CAbase &ca, uint64_t generations) {
+    /* advance the Game of Life on the torus by the given number of generations */
+
+    ca.setGeneration(ca.getGeneration() + generations);
+    for (int k = 0; generations != 0; k++, generations >>= 1) {
+        if (generations & 1) step(ca, k);
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef HASHLIFE_H
+#define HASHLIFE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <unordered_map>
+#include "CAbase.h"
+
+class HashLife {
+    /* memoised quadtree (HashLife) engine for the Game of Life on the torus
+     *
+     * Quadtree nodes are hash-consed, and every node caches its centre advanced in time, so regions
+     * that repeat in space or time are only ever computed once. The torus is tiled periodically over
+     * a square node big enough that its centre, advanced by 2^k generations, still covers one full
+     * period; that centre is folded back onto the torus. A jump of n generations takes one such
+     * macro step for every set bit of n.
+     *
+     * The node store is bounded: once it holds more than maxNodes nodes between two macro steps, the
+     * nodes not reachable from the last universe are collected and the store is compacted.
+     */
+
+public:
+    HashLife();
+
+    void jump(CAbase &ca, uint64_t generations);
+
+    void clear();
+
+    size_t getNodeCount() const {
+        return nodes.size();
+    }
+
+    size_t getMaxNodes() const {
+        return maxNodes;
+    }
+
+    void setMaxNodes(size_t n) {
+        maxNodes = n;
+    }
+
+private:
+    struct Node {
+        uint32_t nw, ne, sw, se; // children (none for the two leaves)
+        uint32_t result;         // centre after min(2^stepLog, 2^(level - 2)) generations, or none
+        uint32_t next;           // hash chain
+        uint8_t level;           // side length 2^level
+        uint8_t mark;            // reachable during garbage collection
+    };
+
+    static const uint32_t none = 0xffffffffu;
+    static const int memoLevel = 4; // tiles from this level up are memoised while building
+
+    std::vector<Node> nodes;       // nodes[0] and nodes[1] are the dead and the living cell
+    std::vector<uint32_t> buckets; // heads of the hash chains
+    std::vector<uint32_t> empty;   // empty node per level, or none
+    int stepLog;
+    size_t maxNodes;
+    uint32_t lastRoot;
+
+    uint32_t join(uint32_t nw, uint32_t ne, uint32_t sw, uint32_t se);
+    uint32_t emptyNode(int level);
+    uint32_t centre(uint32_t n);
+    uint32_t result(uint32_t n);
+    uint32_t resultLevel2(uint32_t n);
+    void setStepLog(int j);
+    void rehash(size_t size);
+    void collect();
+
+    uint32_t build(const CAview &v, int level, uint64_t xo, uint64_t yo,
+                   const std::vector<uint64_t> &sideX, const std::vector<uint64_t> &sideY,
+                   std::unordered_map<uint64_t, uint32_t> &memo);
+    void extract(CAbase &ca, uint32_t n, int level, uint64_t x0, uint64_t y0, uint64_t shiftX, uint64_t shiftY);
+    void step(CAbase &ca, int k);
+};
+
+
+#endif // HASHLIFE_H
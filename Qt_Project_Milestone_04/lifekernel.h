@@ -0,0 +1,392 @@
+#ifndef LIFEKERNEL_H
+#define LIFEKERNEL_H
+
+#include <stdint.h>
+#include <string.h>
+#include "bitplane.h"
+#include "rules.h"
+
+/* Bitsliced kernels for Life-like (B/S) rules on BitPlane rows
+ *
+ * The eight neighbour words of a cell word are summed by a boolean full-adder network into a
+ * bitsliced 4-bit count, so one pass decides the rule for 64 cells per 64-bit lane. The rule masks
+ * are template arguments: the terms of counts a rule does not use fold away at compile time, which
+ * leaves B3/S23 with the same handful of operations as a hand-written Life network. Rules entered at
+ * runtime use the same network with the masks as broadcast constants. Every kernel is instantiated
+ * for 1, 2, 4 and 8 lanes (scalar, SSE2, AVX2, AVX-512) via GCC/Clang vector extensions and the
+ * widest variant the CPU supports is picked at runtime.
+ */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LIFEKERNEL_X86 1
+typedef uint64_t LifeVec2 __attribute__((vector_size(16)));
+typedef uint64_t LifeVec4 __attribute__((vector_size(32)));
+typedef uint64_t LifeVec8 __attribute__((vector_size(64)));
+#define LIFEKERNEL_INLINE inline __attribute__((always_inline))
+#else
+#define LIFEKERNEL_INLINE inline
+#endif
+
+template <class V>
+LIFEKERNEL_INLINE V lifeLoad(const uint64_t *p) {
+    V v;
+    memcpy(&v, p, sizeof(V));
+    return v;
+}
+
+
+template <class V>
+LIFEKERNEL_INLINE void lifeStore(uint64_t *p, V v) {
+    memcpy(p, &v, sizeof(V));
+}
+
+
+template <class V>
+LIFEKERNEL_INLINE void lifeFullAdder(V a, V b, V c, V &sum, V &carry) {
+    V t = a ^ b;
+    sum = t ^ c;
+    carry = (a & b) | (t & c);
+}
+
+
+template <class V>
+LIFEKERNEL_INLINE void lifeCount(const uint64_t *up, const uint64_t *mid, const uint64_t *down,
+                                 V &m, V &n0, V &n1, V &n2, V &n3) {
+    /* state m and bitsliced neighbour count n3 n2 n1 n0 (0 .. 8) of the cells in the lanes at mid[0] */
+
+    V u = lifeLoad<V>(up), uW = lifeLoad<V>(up - 1), uE = lifeLoad<V>(up + 1);
+    m = lifeLoad<V>(mid);
+    V mW = lifeLoad<V>(mid - 1), mE = lifeLoad<V>(mid + 1);
+    V d = lifeLoad<V>(down), dW = lifeLoad<V>(down - 1), dE = lifeLoad<V>(down + 1);
+
+    // the eight neighbours, shifted into the column of the cell they belong to
+    V nw = (u << 1) | (uW >> 63), n = u, ne = (u >> 1) | (uE << 63);
+    V w = (m << 1) | (mW >> 63), e = (m >> 1) | (mE << 63);
+    V sw = (d << 1) | (dW >> 63), s = d, se = (d >> 1) | (dE << 63);
+
+    // first layer: three adders give the ones digit and four carries of weight two
+    V s1, c1, s2, c2, c4;
+    lifeFullAdder<V>(nw, n, ne, s1, c1);
+    lifeFullAdder<V>(w, e, sw, s2, c2);
+    V s3 = s ^ se, c3 = s & se;
+    lifeFullAdder<V>(s1, s2, s3, n0, c4);
+
+    // second layer: sum of the four carries
+    V twos, fours;
+    lifeFullAdder<V>(c1, c2, c3, twos, fours);
+    V carry = twos & c4;
+    n1 = twos ^ c4;
+    n2 = fours ^ carry;
+    n3 = fours & carry;
+}
+
+
+template <class V>
+LIFEKERNEL_INLINE V ruleApply(V m, V n0, V n1, V n2, V n3, const V *birth, const V *survival) {
+    /* next state for a rule given as one all-ones or all-zero mask per neighbour count
+     *
+     * Counts are taken in pairs 2j, 2j + 1 that share n1 and n2, so within a pair the rule is a
+     * function of m and n0 only. */
+
+    V next = n3 & ((~m & birth[8]) | (m & survival[8]));
+    for (int j = 0; j < 4; j++) {
+        V pair = ((j & 1) ? n1 : ~n1) & ((j & 2) ? n2 : ~n2);
+        if (j == 0) pair &= ~n3; // count 8 also has n2 n1 n0 = 0
+        V dead = (~n0 & birth[2 * j]) | (n0 & birth[2 * j + 1]);
+        V alive = (~n0 & survival[2 * j]) | (n0 & survival[2 * j + 1]);
+        next |= pair & ((~m & dead) | (m & alive));
+    }
+    return next;
+}
+
+
+template <class V>
+LIFEKERNEL_INLINE void ruleMasks(uint16_t mask, V *masks) {
+    // one all-ones or all-zero constant per neighbour count
+    for (int k = 0; k <= 8; k++) {
+        masks[k] = V() - (V() + ((mask >> k) & 1));
+    }
+}
+
+
+template <class V, uint16_t B, uint16_t S, int j>
+LIFEKERNEL_INLINE V rulePair(V m, V n0, V n1, V n2, V n3) {
+    /* cells of the compile-time rule B/S with 2j or 2j + 1 neighbours (j = 4 for all eight)
+     *
+     * The rule bits are constants here, so the compiler drops the pair if the rule has no such
+     * count and otherwise reduces it to a few operations, e.g. n1 & ~n2 & (n0 | m) for S23. */
+
+    const bool birthEven = (B >> (2 * j)) & 1, birthOdd = (B >> (2 * j + 1)) & 1;
+    const bool survivalEven = (S >> (2 * j)) & 1, survivalOdd = (S >> (2 * j + 1)) & 1;
+    if (!birthEven && !birthOdd && !survivalEven && !survivalOdd) return V();
+
+    V pair = ((j & 1) ? n1 : ~n1) & ((j & 2) ? n2 : ~n2);
+    if (j == 0) pair &= ~n3; // count 8 also has n2 n1 n0 = 0
+    if (j == 4) pair = n3;
+    V dead = (birthEven ? ~n0 : V()) | (birthOdd ? n0 : V());
+    V alive = (survivalEven ? ~n0 : V()) | (survivalOdd ? n0 : V());
+    return pair & ((~m & dead) | (m & alive));
+}
+
+
+template <class V, uint16_t B, uint16_t S>
+LIFEKERNEL_INLINE V ruleWord(const uint64_t *up, const uint64_t *mid, const uint64_t *down) {
+    /* next state of the cells in the lanes at mid[0] under the compile-time rule B/S */
+
+    V m, n0, n1, n2, n3;
+    lifeCount<V>(up, mid, down, m, n0, n1, n2, n3);
+    return rulePair<V, B, S, 0>(m, n0, n1, n2, n3) | rulePair<V, B, S, 1>(m, n0, n1, n2, n3) |
+           rulePair<V, B, S, 2>(m, n0, n1, n2, n3) | rulePair<V, B, S, 3>(m, n0, n1, n2, n3) |
+           rulePair<V, B, S, 4>(m, n0, n1, n2, n3);
+}
+
+
+template <class V, uint16_t B, uint16_t S>
+LIFEKERNEL_INLINE uint64_t ruleRow(const uint64_t *up, const uint64_t *mid, const uint64_t *down, uint64_t *out,
+                                   int words, uint64_t lastMask) {
+    /* evolve one row under the rule B/S and return the cells that changed */
+
+    const int lanes = sizeof(V) / sizeof(uint64_t);
+    int i = 0;
+
+    // the last word is left to the scalar tail since it has to be masked
+    V changedLanes = V();
+    for (; i + lanes < words; i += lanes) {
+        V next = ruleWord<V, B, S>(up + i, mid + i, down + i);
+        lifeStore<V>(out + i, next);
+        changedLanes |= next ^ lifeLoad<V>(mid + i);
+    }
+    uint64_t changed = 0;
+    for (int k = 0; k < lanes; k++) {
+        changed |= ((const uint64_t *) &changedLanes)[k];
+    }
+
+    for (; i < words - 1; i++) {
+        out[i] = ruleWord<uint64_t, B, S>(up + i, mid + i, down + i);
+        changed |= out[i] ^ mid[i];
+    }
+    out[words - 1] = ruleWord<uint64_t, B, S>(up + i, mid + i, down + i) & lastMask;
+    changed |= (out[words - 1] ^ mid[words - 1]) & lastMask;
+    return changed;
+}
+
+
+template <class V>
+LIFEKERNEL_INLINE uint64_t ruleRowDynamic(const uint64_t *up, const uint64_t *mid, const uint64_t *down, uint64_t *out,
+                                          int words, uint64_t lastMask, LifeRule rule) {
+    /* evolve one row under a rule only known at runtime and return the cells that changed */
+
+    const int lanes = sizeof(V) / sizeof(uint64_t);
+    V birth[9], survival[9];
+    uint64_t birth1[9], survival1[9];
+    ruleMasks<V>(rule.birth, birth);
+    ruleMasks<V>(rule.survival, survival);
+    ruleMasks<uint64_t>(rule.birth, birth1);
+    ruleMasks<uint64_t>(rule.survival, survival1);
+    int i = 0;
+
+    V changedLanes = V();
+    for (; i + lanes < words; i += lanes) {
+        V m, n0, n1, n2, n3;
+        lifeCount<V>(up + i, mid + i, down + i, m, n0, n1, n2, n3);
+        V next = ruleApply<V>(m, n0, n1, n2, n3, birth, survival);
+        lifeStore<V>(out + i, next);
+        changedLanes |= next ^ m;
+    }
+    uint64_t changed = 0;
+    for (int k = 0; k < lanes; k++) {
+        changed |= ((const uint64_t *) &changedLanes)[k];
+    }
+
+    for (; i < words; i++) {
+        uint64_t m, n0, n1, n2, n3;
+        lifeCount<uint64_t>(up + i, mid + i, down + i, m, n0, n1, n2, n3);
+        out[i] = ruleApply<uint64_t>(m, n0, n1, n2, n3, birth1, survival1);
+        if (i == words - 1) out[i] &= lastMask;
+        changed |= (out[i] ^ m) & ((i == words - 1) ? lastMask : ~uint64_t(0));
+    }
+    return changed;
+}
+
+
+// row kernel for a rule entered at runtime
+typedef uint64_t (*RuleRowFunction)(const uint64_t *up, const uint64_t *mid, const uint64_t *down, uint64_t *out,
+                                    int words, uint64_t lastMask, LifeRule rule);
+
+
+template <uint16_t B, uint16_t S>
+inline uint64_t ruleRowScalar(const uint64_t *up, const uint64_t *mid, const uint64_t *down, uint64_t *out,
+                              int words, uint64_t lastMask) {
+    return ruleRow<uint64_t, B, S>(up, mid, down, out, words, lastMask);
+}
+
+
+inline uint64_t ruleRowDynamicScalar(const uint64_t *up, const uint64_t *mid, const uint64_t *down, uint64_t *out,
+                                     int words, uint64_t lastMask, LifeRule rule) {
+    return ruleRowDynamic<uint64_t>(up, mid, down, out, words, lastMask, rule);
+}
+
+
+#ifdef LIFEKERNEL_X86
+template <uint16_t B, uint16_t S>
+__attribute__((target("sse2")))
+inline uint64_t ruleRowSse2(const uint64_t *up, const uint64_t *mid, const uint64_t *down, uint64_t *out,
+                            int words, uint64_t lastMask) {
+    return ruleRow<LifeVec2, B, S>(up, mid, down, out, words, lastMask);
+}
+
+
+template <uint16_t B, uint16_t S>
+__attribute__((target("avx2")))
+inline uint64_t ruleRowAvx2(const uint64_t *up, const uint64_t *mid, const uint64_t *down, uint64_t *out,
+                            int words, uint64_t lastMask) {
+    return ruleRow<LifeVec4, B, S>(up, mid, down, out, words, lastMask);
+}
+
+
+template <uint16_t B, uint16_t S>
+__attribute__((target("avx512f")))
+inline uint64_t ruleRowAvx512(const uint64_t *up, const uint64_t *mid, const uint64_t *down, uint64_t *out,
+                              int words, uint64_t lastMask) {
+    return ruleRow<LifeVec8, B, S>(up, mid, down, out, words, lastMask);
+}
+
+
+__attribute__((target("sse2")))
+inline uint64_t ruleRowDynamicSse2(const uint64_t *up, const uint64_t *mid, const uint64_t *down, uint64_t *out,
+                                   int words, uint64_t lastMask, LifeRule rule) {
+    return ruleRowDynamic<LifeVec2>(up, mid, down, out, words, lastMask, rule);
+}
+
+
+__attribute__((target("avx2")))
+inline uint64_t ruleRowDynamicAvx2(const uint64_t *up, const uint64_t *mid, const uint64_t *down, uint64_t *out,
+                                   int words, uint64_t lastMask, LifeRule rule) {
+    return ruleRowDynamic<LifeVec4>(up, mid, down, out, words, lastMask, rule);
+}
+
+
+__attribute__((target("avx512f")))
+inline uint64_t ruleRowDynamicAvx512(const uint64_t *up, const uint64_t *mid, const uint64_t *down, uint64_t *out,
+                                     int words, uint64_t lastMask, LifeRule rule) {
+    return ruleRowDynamic<LifeVec8>(up, mid, down, out, words, lastMask, rule);
+}
+#endif
+
+
+struct LifeKernel {
+    const char *name;
+    BitRowFunction row;
+};
+
+
+struct RuleKernel {
+    const char *name;
+    RuleRowFunction row;
+};
+
+
+inline const char *selectLifeKernelWidth() {
+    /* widest vector extension the CPU supports */
+
+#ifdef LIFEKERNEL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return "avx512";
+    if (__builtin_cpu_supports("avx2")) return "avx2";
+    if (__builtin_cpu_supports("sse2")) return "sse2";
+#endif
+    return "scalar";
+}
+
+
+template <uint16_t B, uint16_t S>
+inline LifeKernel selectRuleKernel() {
+    const char *width = selectLifeKernelWidth();
+#ifdef LIFEKERNEL_X86
+    if (width[0] == 'a' && width[3] == '5') return {width, ruleRowAvx512<B, S>};
+    if (width[0] == 'a') return {width, ruleRowAvx2<B, S>};
+    if (width[0] == 's' && width[1] == 's') return {width, ruleRowSse2<B, S>};
+#endif
+    return {width, ruleRowScalar<B, S>};
+}
+
+
+template <uint16_t B, uint16_t S>
+inline const LifeKernel &ruleKernel() {
+    // selected once per process and rule
+    static const LifeKernel kernel = selectRuleKernel<B, S>();
+    return kernel;
+}
+
+
+inline const LifeKernel &lifeKernel() {
+    return ruleKernel<ruleBirthMask(RULE_LIFE), ruleSurvivalMask(RULE_LIFE)>();
+}
+
+
+inline const LifeKernel &fluidsKernel() {
+    return ruleKernel<ruleBirthMask(RULE_FLUIDS), ruleSurvivalMask(RULE_FLUIDS)>();
+}
+
+
+inline RuleKernel selectDynamicRuleKernel() {
+    const char *width = selectLifeKernelWidth();
+#ifdef LIFEKERNEL_X86
+    if (width[0] == 'a' && width[3] == '5') return {width, ruleRowDynamicAvx512};
+    if (width[0] == 'a') return {width, ruleRowDynamicAvx2};
+    if (width[0] == 's' && width[1] == 's') return {width, ruleRowDynamicSse2};
+#endif
+    return {width, ruleRowDynamicScalar};
+}
+
+
+inline const RuleKernel &dynamicRuleKernel() {
+    static const RuleKernel kernel = selectDynamicRuleKernel();
+    return kernel;
+}
+
+
+struct PresetRule {
+    const char *name;
+    const char *rule;
+    const LifeKernel &(*kernel)();
+};
+
+
+#define LIFEKERNEL_PRESET(name, rule) {name, rule, &ruleKernel<ruleBirthMask(rule), ruleSurvivalMask(rule)>}
+
+inline const PresetRule *presetRules(int &count) {
+    /* well-known rules with a compiled kernel of their own */
+
+    static const PresetRule presets[] = {
+        LIFEKERNEL_PRESET("Life", RULE_LIFE),
+        LIFEKERNEL_PRESET("HighLife", RULE_HIGHLIFE),
+        LIFEKERNEL_PRESET("Day & Night", RULE_DAYNIGHT),
+        LIFEKERNEL_PRESET("Seeds", RULE_SEEDS),
+        LIFEKERNEL_PRESET("Life without Death", RULE_NODEATH),
+        LIFEKERNEL_PRESET("Maze", RULE_MAZE),
+        LIFEKERNEL_PRESET("Replicator", RULE_REPLICATOR),
+        LIFEKERNEL_PRESET("2x2", RULE_2X2),
+        LIFEKERNEL_PRESET("Morley", RULE_MORLEY),
+        LIFEKERNEL_PRESET("Anneal", RULE_ANNEAL),
+        LIFEKERNEL_PRESET("Fluids", RULE_FLUIDS),
+    };
+    count = sizeof(presets) / sizeof(presets[0]);
+    return presets;
+}
+
+
+inline const LifeKernel *presetRuleKernel(LifeRule rule) {
+    /* compiled kernel for the rule, or nullptr if it has none */
+
+    int count;
+    const PresetRule *presets = presetRules(count);
+    for (int i = 0; i < count; i++) {
+        LifeRule p = makeRule(presets[i].rule);
+        if (p.birth == rule.birth && p.survival == rule.survival) return &presets[i].kernel();
+    }
+    return nullptr;
+}
+
+
+#endif // LIFEKERNEL_H
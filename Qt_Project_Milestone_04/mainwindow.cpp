@@ -1,14 +1,19 @@
-#include <QTextStream>
+#include <QFile>
 #include <QFileDialog>
 #include <QDebug>
 #include <QColor>
 #include <QMessageBox>
 #include <QColorDialog>
+#include <QThread>
+#include <QSignalBlocker>
+#include <QStatusBar>
 #include <ctime>
+#include <fstream>
 
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 #include "keypressfilter.h"
+#include "patternio.h"
 
 
 MainWindow::MainWindow(QWidget *parent) :
@@ -27,6 +32,15 @@ MainWindow::MainWindow(QWidget *parent) :
     ui->universeModeControl->addItem("Erosion");
     ui->universeModeControl->addItem("Fluids");
     ui->universeModeControl->addItem("Gases");
+    ui->universeModeControl->addItem("Custom Rule");
+
+    /* rules with a compiled kernel, any other B/S rule can be typed in */
+    int presetCount;
+    const PresetRule *presets = presetRules(presetCount);
+    for (int i = 0; i < presetCount; i++) {
+        ui->ruleControl->addItem(presets[i].rule);
+        ui->ruleControl->setItemData(i, presets[i].name, Qt::ToolTipRole);
+    }
 
     /* color icons for color buttons */
     QPixmap icon(16, 16);
@@ -37,16 +51,32 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(ui->startButton, SIGNAL(clicked()), game, SLOT(startGame()));
     connect(ui->stopButton, SIGNAL(clicked()), game, SLOT(stopGame()));
     connect(ui->clearButton, SIGNAL(clicked()), game, SLOT(clearGame()));
+    connect(ui->jumpButton, SIGNAL(clicked()), this, SLOT(jumpGame()));
 
     /* spin boxes */
     connect(ui->intervalControl, SIGNAL(valueChanged(int)), game, SLOT(setInterval(int)));
-    connect(ui->universeSizeControl, SIGNAL(valueChanged(int)), game, SLOT(setUniverseSize(int)));
+    connect(ui->universeSizeControl, SIGNAL(valueChanged(int)), this, SLOT(selectUniverseSize(int)));
     connect(ui->lifetimeControl, SIGNAL(valueChanged(int)), game, SLOT(setLifetime(int)));
+    connect(ui->threadsControl, SIGNAL(valueChanged(int)), game, SLOT(setThreadCount(int)));
+
+    /* turbo: no interval between generations */
+    connect(ui->turboControl, SIGNAL(toggled(bool)), game, SLOT(setTurbo(bool)));
+    connect(ui->turboControl, SIGNAL(toggled(bool)), ui->intervalControl, SLOT(setDisabled(bool)));
+    connect(game, SIGNAL(generationRate(double)), this, SLOT(showRate(double)));
+
+    /* one thread per core by default */
+    ui->threadsControl->setValue(QThread::idealThreadCount());
+
+    /* random seed */
+    ui->seedControl->setText(QString::number(game->getSeed()));
+    connect(ui->seedControl, SIGNAL(editingFinished()), this, SLOT(selectSeed()));
 
     /* combo boxes */
     connect(ui->universeModeControl, SIGNAL(currentIndexChanged(int)), game, SLOT(setUniverseMode(int)));
     connect(ui->universeModeControl, SIGNAL(currentIndexChanged(int)), this, SLOT(globalButtonControl(int)));
     connect(ui->cellModeControl, SIGNAL(currentIndexChanged(int)), game, SLOT(setCellMode(int)));
+    connect(ui->ruleControl, SIGNAL(activated(int)), this, SLOT(selectRule()));
+    connect(ui->ruleControl->lineEdit(), SIGNAL(editingFinished()), this, SLOT(selectRule()));
 
     /* enable/disable interaction during the game */
     connect(game, SIGNAL(gameStarted(int, bool)), this, SLOT(disableControls(int, bool)));
@@ -83,6 +113,17 @@ MainWindow::~MainWindow() {
 }
 
 
+void MainWindow::selectUniverseSize(int s) {
+    /* resize the universe; shows the size that was actually set if there was not enough memory */
+
+    game->setUniverseSize(s);
+    if (game->getUniverseSize() != s) {
+        const QSignalBlocker blocker(ui->universeSizeControl);
+        ui->universeSizeControl->setValue(game->getUniverseSize());
+    }
+}
+
+
 void MainWindow::globalButtonControl(int uM) {
     if (uM != 2) {
         ui->cellModeControl->clear();
@@ -113,6 +154,13 @@ void MainWindow::globalButtonControl(int uM) {
     if (uM == 6) {
         ui->universeSizeControl->setSingleStep(2);
     }
+    // Snake and Predator keep more data per cell than the binary modes; lowering the maximum also
+    // shrinks the universe if it is too large for the new mode
+    ui->universeSizeControl->setMaximum(game->getMaxUniverseSize());
+    // jumping ahead is only offered for the game of life
+    ui->jumpControl->setEnabled(uM == 0);
+    ui->jumpButton->setEnabled(uM == 0);
+    ui->ruleControl->setEnabled(uM == 7);
 
 }
 
@@ -120,7 +168,11 @@ void MainWindow::globalButtonControl(int uM) {
 void MainWindow::enableControls(int uM, bool b) {
     ui->loadButton->setEnabled(b);
     ui->saveButton->setEnabled(b);
-    ui->intervalControl->setEnabled(b);
+    ui->jumpControl->setEnabled(b && uM == 0);
+    ui->jumpButton->setEnabled(b && uM == 0);
+    ui->ruleControl->setEnabled(b && uM == 7);
+    ui->seedControl->setEnabled(b);
+    ui->intervalControl->setEnabled(b && !ui->turboControl->isChecked());
     ui->universeSizeControl->setEnabled(b);
     ui->universeModeControl->setEnabled(b);
 
@@ -137,6 +189,10 @@ void MainWindow::enableControls(int uM, bool b) {
 void MainWindow::disableControls(int uM, bool b) {
     ui->loadButton->setDisabled(b);
     ui->saveButton->setDisabled(b);
+    ui->jumpControl->setDisabled(b);
+    ui->jumpButton->setDisabled(b);
+    ui->ruleControl->setDisabled(b);
+    ui->seedControl->setDisabled(b);
     ui->intervalControl->setDisabled(b);
     ui->universeSizeControl->setDisabled(b);
     ui->universeModeControl->setDisabled(b);
@@ -147,133 +203,96 @@ void MainWindow::disableControls(int uM, bool b) {
 }
 
 
+void MainWindow::showRate(double rate) {
+    /* generations per second achieved by the running game */
+    statusBar()->showMessage(tr("%1 generations/s").arg(rate, 0, 'f', 1));
+}
+
+
 void MainWindow::saveGame() {
     int uM = game->getUniverseMode();
-    QString filename, size, buffer;
-    QColor color;
-    QFile file;
+    QString filename;
 
     switch (uM) {
 
     // GAME OF LIFE
     case 0:
-
         filename = QFileDialog::getSaveFileName(this, tr("Save current game"),
-                                                QDir::homePath(), tr("Game of Life *.game Files (*.game_of_life)"));
-        if (filename.length() < 1)
-            return;
-
-        file.setFileName(filename);
-
-        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
-            QMessageBox::warning(this,
-                                 tr("File Not Saved"),
-                                 tr("For some reason the game could not be written to the chosen file."),
-                                 QMessageBox::Ok);
-            return;
-        }
-
-        size = QString::number(game->getUniverseSize()) + "\n";
-        file.write(size.toUtf8());
-        file.write(game->dumpGame().toUtf8());
-
-        color = game->getMasterColor();
-        buffer = QString::number(color.red()) + " " +
-                         QString::number(color.green()) + " " +
-                         QString::number(color.blue()) + "\n";
-        file.write(buffer.toUtf8());
-        buffer.clear();
-        buffer = QString::number(ui->intervalControl->value()) + "\n";
-        file.write(buffer.toUtf8());
-        file.close();
+                                                QDir::homePath(), tr("Game of Life *.game Files (*.game_of_life);;"
+                                                                     "Life Pattern (*.rle);;Macrocell Pattern (*.mc);;Snapshot (*.snapshot)"));
         break;
 
     //  SNAKE
     case 1:
         filename = QFileDialog::getSaveFileName(this, tr("Save current game"),
-                                                QDir::homePath(), tr("Snake *.snake Files (*.snake)"));
-        if (filename.length() < 1)
-            return;
-
-        file.setFileName(filename);
-
-        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
-            QMessageBox::warning(this,
-                                 tr("File Not Saved"),
-                                 tr("For some reason the game could not be written to the chosen file."),
-                                 QMessageBox::Ok);
-            return;
-        }
-
-        color = game->getMasterColor();
-
-        buffer = QString::number(game->getUniverseSize()) + "\n";
-
-        buffer += QString::number(color.red()) + " " +
-                  QString::number(color.green()) + " " +
-                  QString::number(color.blue()) + "\n";
-
-        buffer += QString::number(ui->intervalControl->value()) + "\n";
-
-        buffer += QString::number(game->getCA().directionSnake.past) + "\n" +
-                  QString::number(game->getCA().directionSnake.future) + "\n" +
-                  QString::number(game->getCA().getSnakeLength()) + "\n" +
-                  QString::number(game->getCA().getSnakeAction()) + "\n" +
-
-                  QString::number(game->getCA().positionSnakeHead.x) + " " + QString::number(game->getCA().positionSnakeHead.y) + "\n" +
-                  QString::number(game->getCA().positionFood.x) + " " + QString::number(game->getCA().positionFood.y) + "\n";
-        file.write(buffer.toUtf8());
-        buffer.clear();
-
-        file.write(game->dumpGame().toUtf8());
-        file.close();
-
+                                                QDir::homePath(), tr("Snake *.snake Files (*.snake);;Snapshot (*.snapshot)"));
         break;
 
     // PREDATOR
     case 2:
         filename = QFileDialog::getSaveFileName(this, tr("Save current game"),
-                                                QDir::homePath(), tr("Predator *.predator Files (*.predator)"));
-        if (filename.length() < 1)
-            return;
+                                                QDir::homePath(), tr("Predator *.predator Files (*.predator);;Snapshot (*.snapshot)"));
+        break;
 
-        file.setFileName(filename);
+    default:
+        break;
+    }
+
+    if (filename.length() < 1)
+        return;
 
-        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    // snapshots are an image of the memory of the automaton
+    if (isSnapshotFile(QFile::encodeName(filename).toStdString())) {
+        if (!game->saveSnapshot(QFile::encodeName(filename).constData())) {
             QMessageBox::warning(this,
                                  tr("File Not Saved"),
                                  tr("For some reason the game could not be written to the chosen file."),
                                  QMessageBox::Ok);
-            return;
         }
+        return;
+    }
 
-        color = game->getMasterColor();
-
-        buffer = QString::number(game->getUniverseSize()) + "\n";
-
-        buffer += QString::number(color.red()) + " " +
-                  QString::number(color.green()) + " " +
-                  QString::number(color.blue()) + "\n";
-
-        buffer += QString::number(ui->intervalControl->value()) + "\n";
-
-        buffer +=QString::number(ui->cellModeControl->currentIndex()) + "\n";
-
-        file.write(buffer.toUtf8());
-        buffer.clear();
-
-        file.write(game->dumpGame().toUtf8());
-
-        buffer +=QString::number(ui->lifetimeControl->value()) + "\n";
-
-        file.write(buffer.toUtf8());
-        buffer.clear();
-
-        file.write(game->dumpGame('l').toUtf8());
+    // written straight into the file a row at a time
+    std::ofstream out(QFile::encodeName(filename).constData(), std::ios::binary | std::ios::trunc);
+    if (!out) {
+        QMessageBox::warning(this,
+                             tr("File Not Saved"),
+                             tr("For some reason the game could not be written to the chosen file."),
+                             QMessageBox::Ok);
+        return;
+    }
 
-        file.close();
+    // patterns for Golly and other Life programs only hold the cells
+    int format = patternFormatOfFile(QFile::encodeName(filename).toStdString());
+    if (format >= 0) {
+        game->savePattern(out, format);
+        out.close();
+        if (!out) {
+            QMessageBox::warning(this,
+                                 tr("File Not Saved"),
+                                 tr("For some reason the game could not be written to the chosen file."),
+                                 QMessageBox::Ok);
+        }
+        return;
+    }
 
-        break;
+    // the file format is shared with the headless CLI (gameio.h)
+    GameFile settings;
+    QColor color = game->getMasterColor();
+    settings.red = color.red();
+    settings.green = color.green();
+    settings.blue = color.blue();
+    settings.interval = ui->intervalControl->value();
+    settings.cellMode = ui->cellModeControl->currentIndex();
+    settings.lifetime = ui->lifetimeControl->value();
+
+    game->saveGame(out, settings);
+    out.close();
+    if (!out) {
+        QMessageBox::warning(this,
+                             tr("File Not Saved"),
+                             tr("For some reason the game could not be written to the chosen file."),
+                             QMessageBox::Ok);
     }
 }
 
@@ -282,26 +301,26 @@ void MainWindow::loadGame() {
 
     int uM = game->getUniverseMode();
     QString filename;
-    QFile file;
 
     switch (uM) {
 
     // GAME OF LIFE
     case 0:
         filename = QFileDialog::getOpenFileName(this, tr("Open saved game"),
-                                                QDir::homePath(), tr("Game of Life File (*.game_of_life)"));
+                                                QDir::homePath(), tr("Game of Life File (*.game_of_life);;"
+                                                                     "Life Pattern (*.rle *.mc);;Snapshot (*.snapshot)"));
         break;
 
     // SNAKE
     case 1:
         filename = QFileDialog::getOpenFileName(this, tr("Open saved game"),
-                                                QDir::homePath(), tr("Snake File (*.snake)"));
+                                                QDir::homePath(), tr("Snake File (*.snake);;Snapshot (*.snapshot)"));
         break;
 
     // PREDATOR
     case 2:
         filename = QFileDialog::getOpenFileName(this, tr("Open saved game"),
-                                                QDir::homePath(), tr("Predator File (*.predator)"));
+                                                QDir::homePath(), tr("Predator File (*.predator);;Snapshot (*.snapshot)"));
         break;
 
     default:
@@ -310,138 +329,89 @@ void MainWindow::loadGame() {
 
     if (filename.length() < 1)
         return;
-    file.setFileName(filename);
 
-    if (!file.open(QIODevice::ReadOnly)){
+    // snapshots are mapped, and only hold the automaton
+    if (isSnapshotFile(QFile::encodeName(filename).toStdString())) {
+        bool ok = game->loadSnapshot(QFile::encodeName(filename).constData());
+        {
+            const QSignalBlocker blocker(ui->universeSizeControl);
+            ui->universeSizeControl->setValue(game->getUniverseSize());
+        }
+        if (!ok) {
+            QMessageBox::warning(this,
+                                 tr("File Not Loaded"),
+                                 tr("The chosen file is not a snapshot of this mode."),
+                                 QMessageBox::Ok);
+        }
+        return;
+    }
+
+    GameFile settings;
+    std::ifstream in(QFile::encodeName(filename).constData(), std::ios::binary);
+    if (!in) {
         QMessageBox::warning(this,
                              tr("File Not Loaded"),
                              tr("For some reason the chosen file could not be loaded."),
                              QMessageBox::Ok);
         return;
     }
-
-    QTextStream file_input_stream(&file);
-    QString dump, tmp;
-    QPixmap icon(16, 16);
-    int r, g, b;
-    int stream_value;
-
-    switch (uM) {
-
-    // GAME OF LIFE
-    case 0:
-        file_input_stream >> stream_value;
-        ui->universeSizeControl->setValue(stream_value);
-
-        game->setUniverseSize(stream_value);
-        dump = "";
-
-        for (int k = 0; k != stream_value; k++) {
-            file_input_stream >> tmp;
-            dump.append(tmp + "\n");
-        }
-        game->reconstructGame(dump);
-
-        /* import the (rgb) cell color */
-        file_input_stream >> r >> g >> b;
-        currentColor = QColor(r, g, b);
-        game->setMasterColor(currentColor);
-
-        /* display specific color as icon on color buttons */
-        icon.fill(currentColor);
-        ui->colorSelectButton->setIcon(QIcon(icon));
-
-        /* import iteration interval */
-        file_input_stream >> r;
-        ui->intervalControl->setValue(r);
-        game->setInterval(r);
-        break;
-
-    // SNAKE
-    case 1:
-        file_input_stream >> stream_value;
-        ui->universeSizeControl->setValue(stream_value);
-        game->setUniverseSize(stream_value);
-
-        file_input_stream >> r >> g >> b;
-        currentColor = QColor(r, g, b);
-        game->setMasterColor(currentColor);
-        icon.fill(currentColor);
-        ui->colorSelectButton->setIcon(QIcon(icon));
-
-        file_input_stream >> r;
-        ui->intervalControl->setValue(r);
-        game->setInterval(r);
-
-        file_input_stream >> r >> g;
-        game->setDirectionSnake(r, g);
-
-        file_input_stream >> r;
-        game->setSnakeLength(r);
-
-        file_input_stream >> r;
-        game->setSnakeAction(r);
-
-        file_input_stream >> r >> g;
-        game->setPositionSnakeHead(r, g);
-
-        file_input_stream >> r >> g;
-        game->setPositionFood(r, g);
-
-        dump = "";
-        for (int k = 0; k != stream_value; k++) {
-            file_input_stream >> tmp;
-            dump.append(tmp + "\n");
-        }
-        //qDebug() << dump;
-        game->reconstructGame(dump);
-        break;
-
-    // PREDATOR
-    case 2:
-        file_input_stream >> stream_value;
-        ui->universeSizeControl->setValue(stream_value);
-        game->setUniverseSize(stream_value);
-
-        file_input_stream >> r >> g >> b;
-        currentColor = QColor(r, g, b);
-        game->setMasterColor(currentColor);
-        icon.fill(currentColor);
-        ui->colorSelectButton->setIcon(QIcon(icon));
-
-        file_input_stream >> r;
-        ui->intervalControl->setValue(r);
-        game->setInterval(r);
-
-        file_input_stream >> r;
-        ui->cellModeControl->setCurrentIndex(r);
-
-        // reconstruct world
-        dump = "";
-        for (int k = 0; k != stream_value; k++) {
-            file_input_stream >> tmp;
-            dump.append(tmp + "\n");
+    int format = patternFormatOfFile(QFile::encodeName(filename).toStdString());
+    QString rule;
+    bool ok = (format >= 0) ? game->loadPattern(in, format, rule) : game->loadGame(in, settings);
+
+    // the universe already has the size of the file, so the size control must not reset it
+    {
+        const QSignalBlocker blocker(ui->universeSizeControl);
+        ui->universeSizeControl->setValue(game->getUniverseSize());
+    }
+    if (!ok && format >= 0) {
+        QMessageBox::warning(this,
+                             tr("File Not Loaded"),
+                             tr("The chosen file is not a Life pattern, or it is larger than %1 cells.")
+                             .arg(game->getMaxUniverseSize()),
+                             QMessageBox::Ok);
+        return;
+    }
+    if (format >= 0) {
+        // patterns only hold the cells, and the rule they were made for
+        if (rule != "B3/S23") {
+            QMessageBox::information(this,
+                                     tr("Different Rule"),
+                                     tr("The pattern was made for the rule %1, it evolves by the rules of the Game of Life here.")
+                                     .arg(rule),
+                                     QMessageBox::Ok);
         }
-        game->reconstructGame(dump);
+        return;
+    }
+    if (!ok) {
+        QMessageBox::warning(this,
+                             tr("File Not Loaded"),
+                             tr("The chosen file is not a saved game of this mode."),
+                             QMessageBox::Ok);
+        return;
+    }
 
-        file_input_stream >> r;
-        ui->lifetimeControl->setValue(r);
-        game->setLifetime(r);
+    /* import the (rgb) cell color */
+    currentColor = QColor(settings.red, settings.green, settings.blue);
+    game->setMasterColor(currentColor);
 
-        // reconstruct lifetime
-        dump = "";
-        for (int k = 0; k != stream_value; k++) {
-            file_input_stream >> tmp;
-            dump.append(tmp + "\n");
-        }
-        game->reconstructGame(dump, 'l');
+    /* display specific color as icon on color buttons */
+    QPixmap icon(16, 16);
+    icon.fill(currentColor);
+    ui->colorSelectButton->setIcon(QIcon(icon));
 
-        break;
+    /* import iteration interval */
+    ui->intervalControl->setValue(settings.interval);
+    game->setInterval(settings.interval);
 
-    default:
-        break;
+    if (uM == 2) {
+        ui->cellModeControl->setCurrentIndex(settings.cellMode);
+        ui->lifetimeControl->setValue(settings.lifetime);
+        game->setLifetime(settings.lifetime);
+    }
+    if (settings.hasSeed) {
+        ui->seedControl->setText(QString::number(game->getSeed()));
     }
-
 }
 
 
@@ -480,3 +450,49 @@ void MainWindow::selectRandomColor() {
     icon.fill(color);
     ui->colorSelectButton->setIcon(QIcon(icon));
 }
+
+
+void MainWindow::jumpGame() {
+    /* jump the game of life ahead by the number of generations entered */
+
+    bool ok;
+    qulonglong n = ui->jumpControl->text().toULongLong(&ok);
+    if (!ok) {
+        QMessageBox::warning(this,
+                             tr("Invalid Input"),
+                             tr("Please enter the number of generations to jump as a whole number."),
+                             QMessageBox::Ok);
+        return;
+    }
+    game->jumpGenerations(n);
+}
+
+
+void MainWindow::selectRule() {
+    /* hand the rule entered for the custom rule mode to the game */
+
+    if (game->setRule(ui->ruleControl->currentText())) return;
+
+    QMessageBox::warning(this,
+                         tr("Invalid Rule"),
+                         tr("Please enter the rule in B/S notation, e.g. B3/S23 for the Game of Life."),
+                         QMessageBox::Ok);
+    ui->ruleControl->setEditText(game->getRule());
+}
+
+
+void MainWindow::selectSeed() {
+    /* seed the random numbers of the game with the number entered */
+
+    bool ok;
+    qulonglong seed = ui->seedControl->text().toULongLong(&ok);
+    if (!ok) {
+        QMessageBox::warning(this,
+                             tr("Invalid Input"),
+                             tr("Please enter the random seed as a whole number."),
+                             QMessageBox::Ok);
+        ui->seedControl->setText(QString::number(game->getSeed()));
+        return;
+    }
+    game->setSeed(seed);
+}
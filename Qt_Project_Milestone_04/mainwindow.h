@@ -22,9 +22,14 @@ public slots:
     void selectRandomColor();
     void saveGame();
     void loadGame();
+    void jumpGame();
+    void selectRule();
+    void selectSeed();
+    void selectUniverseSize(int s);
     void globalButtonControl(int uM);
     void enableControls(int uM, bool b);
     void disableControls(int uM, bool b);
+    void showRate(double rate);
 
 private:
     Ui::MainWindow *ui;
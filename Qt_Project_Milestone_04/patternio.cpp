@@ -0,0 +1,553 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "patternio.h"
+
+
+static int lowestBit(uint64_t w) {
+    // index of the lowest set bit of a word that is not 0
+#if defined(__GNUC__)
+    return __builtin_ctzll(w);
+#else
+    int i = 0;
+    while (!(w & 1)) {
+        w >>= 1;
+        i++;
+    }
+    return i;
+#endif
+}
+
+
+static int highestBit(uint64_t w) {
+    // index of the highest set bit of a word that is not 0
+#if defined(__GNUC__)
+    return 63 - __builtin_clzll(w);
+#else
+    int i = 0;
+    while (w >>= 1) i++;
+    return i;
+#endif
+}
+
+
+static int nextBit(const uint64_t *row, int bits, int from, bool alive) {
+    /* first cell from .. bits - 1 of a bit row that is living (or dead), bits if there is none */
+
+    if (from >= bits) return bits;
+    int words = (bits + 63) / 64;
+    int i = from >> 6;
+    uint64_t w = (alive ? row[i] : ~row[i]) & (~uint64_t(0) << (from & 63));
+    while (!w) {
+        if (++i >= words) return bits;
+        w = alive ? row[i] : ~row[i];
+    }
+    int b = 64 * i + lowestBit(w);
+    return b < bits ? b : bits;
+}
+
+
+int patternFormatOfFile(const std::string &filename) {
+    /* pattern format from the file name suffix, -1 for other files */
+
+    const char *suffixes[] = {".rle", ".mc"};
+    for (int f = 0; f < 2; f++) {
+        std::string suffix = suffixes[f];
+        if (filename.size() >= suffix.size() &&
+            filename.compare(filename.size() - suffix.size(), suffix.size(), suffix) == 0) return f;
+    }
+    return -1;
+}
+
+
+static bool parsePatternRule(std::string text, LifeRule &rule) {
+    /* B/S notation, or S/B ("23/3") of older files; the bounded grid of Golly (":T100,100") is ignored */
+
+    text = text.substr(0, text.find(':'));
+    while (!text.empty() && isspace((unsigned char) text[0])) text.erase(0, 1);
+    while (!text.empty() && isspace((unsigned char) text[text.size() - 1])) text.erase(text.size() - 1);
+    if (parseRule(text, rule)) return true;
+
+    size_t slash = text.find('/');
+    if (slash == std::string::npos) return false;
+    return parseRule("B" + text.substr(slash + 1) + "/S" + text.substr(0, slash), rule);
+}
+
+
+static bool placePattern(CAbase &ca, int size, int64_t w, int64_t h) {
+    /* empty universe of the given size for a pattern of w x h cells, grown if the pattern does not fit */
+
+    int64_t n = size;
+    if (w > n) n = w;
+    if (h > n) n = h;
+    if (n > ca.getMaxSize(ca.getUniverseMode())) return false;
+    ca.resetWorldSize(int(n), int(n));
+    return true;
+}
+
+
+// RLE
+
+static bool readRle(std::istream &in, CAbase &ca, int size, LifeRule &rule) {
+    /* header line after any comment lines, then the runs up to '!' */
+
+    std::string line;
+    do {
+        if (!std::getline(in, line)) return false;
+    } while (line.empty() || line[0] == '#' || line[0] == '\r');
+
+    // x = 3, y = 3, rule = B3/S23
+    int64_t w = -1, h = -1;
+    size_t start = 0;
+    while (start < line.size()) {
+        size_t end = line.find(',', start);
+        if (end == std::string::npos) end = line.size();
+        std::string item = line.substr(start, end - start);
+        size_t equal = item.find('=');
+        if (equal != std::string::npos) {
+            std::string key, value = item.substr(equal + 1);
+            for (size_t i = 0; i < equal; i++) {
+                if (!isspace((unsigned char) item[i])) key += item[i];
+            }
+            while (!value.empty() && isspace((unsigned char) value[0])) value.erase(0, 1);
+            if (key == "x") w = atoll(value.c_str());
+            else if (key == "y") h = atoll(value.c_str());
+            else if (key == "rule" && !parsePatternRule(value, rule)) return false;
+        }
+        start = end + 1;
+    }
+    if (w < 0 || h < 0 || !placePattern(ca, size, w, h)) return false;
+
+    // runs, placed with the top left corner of the box at x0, y0
+    int n = ca.getNx();
+    int64_t x0 = (n - w) / 2, y0 = (n - h) / 2;
+    int64_t x = 0, y = 0, count = 0;
+    std::streambuf *buffer = in.rdbuf();
+    for (int c = buffer->sbumpc(); c != std::streambuf::traits_type::eof() && c != '!'; c = buffer->sbumpc()) {
+        if (c >= '0' && c <= '9') {
+            if (count < (int64_t(1) << 40)) count = 10 * count + (c - '0');
+            continue;
+        }
+        if (isspace(c)) continue;
+        int64_t run = count ? count : 1;
+        count = 0;
+        if (c == '$') {
+            y += run;
+            x = 0;
+        } else if (c == 'b' || c == '.') {
+            x += run;
+        } else if (isalpha(c)) {
+            // 'o', and the states of multi-state rules, which all count as living
+            int64_t row = y0 + y;
+            if (row >= 0 && row < n) {
+                for (int64_t i = x0 + x; i < x0 + x + run && i < n; i++) {
+                    if (i >= 0) ca.setValue(int(i) + 1, int(row) + 1, 1);
+                }
+            }
+            x += run;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+static void writeRle(std::ostream &out, CAbase &ca, LifeRule rule) {
+    /* the bounding box of the living cells, lines of at most 70 characters */
+
+    CAview v = ca.view();
+    int nx = v.getNx(), ny = v.getNy();
+    std::vector<uint64_t> row((nx + 63) / 64);
+
+    // bounding box
+    int minX = nx, maxX = -1, minY = 0, maxY = -1;
+    for (int k = 1; k <= ny; k++) {
+        v.packRow(k, row.data());
+        int first = nextBit(row.data(), nx, 0, true);
+        if (first == nx) continue;
+        if (maxY < 0) minY = k;
+        maxY = k;
+        if (first < minX) minX = first;
+        for (int i = int(row.size()) - 1; i >= 0; i--) {
+            if (!row[i]) continue;
+            if (64 * i + highestBit(row[i]) > maxX) maxX = 64 * i + highestBit(row[i]);
+            break;
+        }
+    }
+    int w = (maxY < 0) ? 0 : maxX - minX + 1, h = (maxY < 0) ? 0 : maxY - minY + 1;
+    out << "x = " << w << ", y = " << h << ", rule = " << ruleString(rule) << "\n";
+
+    // tokens are collected in a buffer and written in blocks
+    std::vector<char> text(1 << 16);
+    size_t used = 0;
+    int column = 0;
+    auto emitRun = [&](int count, char tag) {
+        char token[12];
+        int length = 0;
+        for (int c = (count > 1) ? count : 0; c > 0; c /= 10) token[length++] = char('0' + c % 10);
+        if (column + length + 1 > 70) {
+            text[used++] = '\n';
+            column = 0;
+        }
+        while (length > 0) text[used++] = token[--length], column++;
+        text[used++] = tag;
+        column++;
+        if (used > text.size() - 32) {
+            out.write(text.data(), used);
+            used = 0;
+        }
+    };
+
+    int pendingRows = 0;
+    for (int k = minY; k <= maxY; k++) {
+        v.packRow(k, row.data());
+        int x = minX;
+        for (;;) {
+            int a = nextBit(row.data(), nx, x, true);
+            if (a >= nx) break;
+            int e = nextBit(row.data(), nx, a, false);
+            if (pendingRows) emitRun(pendingRows, '$');
+            pendingRows = 0;
+            if (a > x) emitRun(a - x, 'b');
+            emitRun(e - a, 'o');
+            x = e;
+        }
+        pendingRows++;
+    }
+    emitRun(1, '!');
+    text[used++] = '\n';
+    out.write(text.data(), used);
+}
+
+
+// MACROCELL
+
+struct MacroNode {
+    /* node of a Macrocell file: a leaf of 8x8 cells (bit 8 * row + column) or four quadrants */
+
+    uint64_t leaf;
+    uint32_t child[4];      // nw, ne, sw, se; 0 is the empty node
+    int level;              // side length 2^level, 3 for leaves
+    int64_t x0, y0, x1, y1; // bounding box of the living cells, x1 < x0 if there are none
+};
+
+
+static void drawMacrocell(CAbase &ca, const std::vector<MacroNode> &nodes, uint32_t i, int64_t x, int64_t y) {
+    /* set the living cells of node i with its top left corner at cell x, y (from 0) */
+
+    const MacroNode &node = nodes[i];
+    if (i == 0 || node.x1 < node.x0) return;
+    if (node.level == 3) {
+        for (uint64_t bits = node.leaf; bits; bits &= bits - 1) {
+            int b = lowestBit(bits);
+            ca.setValue(int(x + (b & 7)) + 1, int(y + (b >> 3)) + 1, 1);
+        }
+        return;
+    }
+    int64_t half = int64_t(1) << (node.level - 1);
+    drawMacrocell(ca, nodes, node.child[0], x, y);
+    drawMacrocell(ca, nodes, node.child[1], x + half, y);
+    drawMacrocell(ca, nodes, node.child[2], x, y + half);
+    drawMacrocell(ca, nodes, node.child[3], x + half, y + half);
+}
+
+
+static bool readMacrocell(std::istream &in, CAbase &ca, int size, LifeRule &rule) {
+    /* "[M2]" header, '#' lines (#R holds the rule), then one node per line; the last one is the root */
+
+    std::string line;
+    if (!std::getline(in, line) || line.compare(0, 4, "[M2]") != 0) return false;
+
+    MacroNode empty = {0, {0, 0, 0, 0}, 0, 0, 0, -1, -1};
+    std::vector<MacroNode> nodes(1, empty);
+    while (std::getline(in, line)) {
+        if (!line.empty() && line[line.size() - 1] == '\r') line.erase(line.size() - 1);
+        if (line.empty()) continue;
+        if (line[0] == '#') {
+            if (line.compare(0, 2, "#R") == 0 && !parsePatternRule(line.substr(2), rule)) return false;
+            continue;
+        }
+
+        MacroNode node = empty;
+        if (line[0] == '.' || line[0] == '*' || line[0] == '$') {
+            // leaf: rows of '.' and '*' ending with '$'
+            node.level = 3;
+            int r = 0, c = 0;
+            for (size_t i = 0; i < line.size(); i++) {
+                if (line[i] == '$') {
+                    r++;
+                    c = 0;
+                    continue;
+                }
+                if (r > 7 || c > 7) return false;
+                if (line[i] == '*') {
+                    node.leaf |= uint64_t(1) << (8 * r + c);
+                    if (node.x1 < node.x0) {
+                        node.x0 = node.x1 = c;
+                        node.y0 = node.y1 = r;
+                    }
+                    node.x0 = std::min<int64_t>(node.x0, c);
+                    node.x1 = std::max<int64_t>(node.x1, c);
+                    node.y1 = r;
+                } else if (line[i] != '.') {
+                    return false;
+                }
+                c++;
+            }
+        } else {
+            // level and quadrants: two-state patterns only have leaves below level 4
+            const char *p = line.c_str();
+            char *end;
+            node.level = int(strtol(p, &end, 10));
+            uint64_t q[4];
+            for (int k = 0; k < 4; k++) {
+                if (end == p) return false;
+                p = end;
+                q[k] = strtoull(p, &end, 10);
+            }
+            if (end == p || node.level < 4 || node.level > 62) return false;
+            int64_t half = int64_t(1) << (node.level - 1);
+            for (int k = 0; k < 4; k++) {
+                if (q[k] >= nodes.size() || (q[k] != 0 && nodes[q[k]].level != node.level - 1)) return false;
+                node.child[k] = uint32_t(q[k]);
+                const MacroNode &s = nodes[q[k]];
+                if (s.x1 < s.x0) continue;
+                int64_t dx = (k & 1) ? half : 0, dy = (k & 2) ? half : 0;
+                if (node.x1 < node.x0) {
+                    node.x0 = s.x0 + dx;
+                    node.x1 = s.x1 + dx;
+                    node.y0 = s.y0 + dy;
+                    node.y1 = s.y1 + dy;
+                }
+                node.x0 = std::min(node.x0, s.x0 + dx);
+                node.x1 = std::max(node.x1, s.x1 + dx);
+                node.y0 = std::min(node.y0, s.y0 + dy);
+                node.y1 = std::max(node.y1, s.y1 + dy);
+            }
+        }
+        nodes.push_back(node);
+    }
+    if (nodes.size() < 2) return false;
+
+    // the bounding box of the root is centered in the universe
+    const MacroNode &root = nodes.back();
+    bool alive = (root.x1 >= root.x0);
+    int64_t w = alive ? root.x1 - root.x0 + 1 : 0, h = alive ? root.y1 - root.y0 + 1 : 0;
+    if (!placePattern(ca, size, w, h)) return false;
+    int n = ca.getNx();
+    drawMacrocell(ca, nodes, uint32_t(nodes.size() - 1), (n - w) / 2 - root.x0, (n - h) / 2 - root.y0);
+    return true;
+}
+
+
+template <class K>
+class LineTable {
+    /* open addressing hash table from the contents of a node to its line number (never 0) */
+
+public:
+    LineTable() :
+        slots(1 << 12),
+        used(0)
+        {}
+
+    uint32_t &operator[](const K &key) {
+        // line number of key, 0 for a new key, which the caller must then set
+        if (2 * (used + 1) > slots.size()) grow();
+        size_t mask = slots.size() - 1;
+        for (size_t i = hash(key) & mask;; i = (i + 1) & mask) {
+            Slot &s = slots[i];
+            if (s.line == 0) {
+                s.key = key;
+                used++;
+                return s.line;
+            }
+            if (s.key == key) return s.line;
+        }
+    }
+
+private:
+    struct Slot {
+        K key;
+        uint32_t line;
+    };
+
+    static size_t hash(uint64_t k) {
+        uint64_t h = k * 0x9E3779B97F4A7C15ULL;
+        return size_t(h ^ (h >> 29));
+    }
+
+    template <class Q>
+    static size_t hash(const Q &q) {
+        uint64_t h = q.child[0] * 0x9E3779B97F4A7C15ULL ^ q.child[1] * 0xC2B2AE3D27D4EB4FULL ^
+                     q.child[2] * 0x165667B19E3779F9ULL ^ q.child[3] * 0x27D4EB2F165667C5ULL;
+        return size_t(h ^ (h >> 29));
+    }
+
+    void grow() {
+        std::vector<Slot> old(2 * slots.size());
+        old.swap(slots);
+        size_t mask = slots.size() - 1;
+        for (size_t j = 0; j < old.size(); j++) {
+            if (old[j].line == 0) continue;
+            size_t i = hash(old[j].key) & mask;
+            while (slots[i].line != 0) i = (i + 1) & mask;
+            slots[i] = old[j];
+        }
+    }
+
+    std::vector<Slot> slots;
+    size_t used;
+};
+
+
+class MacrocellWriter {
+    /* hash-consed quadtree of the universe, written node by node as nodes are created
+     *
+     * The universe is padded to a square of 2^k cells and read in strips of 8 rows. Each strip gives
+     * a row of leaves; two rows of nodes of one level give a row of nodes one level up, so only one
+     * pending row per level is kept.
+     */
+
+public:
+    explicit MacrocellWriter(std::ostream &o) :
+        out(o),
+        count(0)
+    {
+        // a leaf row of 8 cells up to its last living one, ending with '$'
+        for (int bits = 0; bits < 256; bits++) {
+            for (int c = 0; bits >> c; c++) rowText[bits] += ((bits >> c) & 1) ? '*' : '.';
+            rowText[bits] += '$';
+        }
+    }
+
+    uint32_t leaf(uint64_t bits) {
+        if (!bits) return 0;
+        uint32_t &line = leaves[bits];
+        if (line) return line;
+        for (int r = 0; r < 8 && (bits >> (8 * r)); r++) text += rowText[(bits >> (8 * r)) & 0xFF];
+        text += '\n';
+        flush(false);
+        return line = ++count;
+    }
+
+    uint32_t join(int level, uint32_t nw, uint32_t ne, uint32_t sw, uint32_t se) {
+        if (!(nw | ne | sw | se)) return 0;
+        Quad key = {{nw, ne, sw, se}};
+        uint32_t &line = quads[key];
+        if (line) return line;
+        char digits[64];
+        text.append(digits, snprintf(digits, sizeof(digits), "%d %u %u %u %u\n", level, nw, ne, sw, se));
+        flush(false);
+        return line = ++count;
+    }
+
+    void flush(bool all) {
+        if (all || text.size() >= (1 << 16)) {
+            out.write(text.data(), text.size());
+            text.clear();
+        }
+    }
+
+    uint32_t addRow(int level, std::vector<uint32_t> &row) {
+        /* a row of nodes of the given level below the pending one; returns the root once it is complete */
+
+        if (row.size() == 1 && pending.size() <= size_t(level)) return row[0];
+        if (pending.size() <= size_t(level)) pending.resize(level + 1);
+        std::vector<uint32_t> &top = pending[level];
+        if (top.empty()) {
+            top.swap(row);
+            return 0;
+        }
+        std::vector<uint32_t> up(row.size() / 2);
+        for (size_t i = 0; i < up.size(); i++) up[i] = join(level + 1, top[2 * i], top[2 * i + 1], row[2 * i], row[2 * i + 1]);
+        top.clear();
+        return addRow(level + 1, up);
+    }
+
+private:
+    struct Quad {
+        uint32_t child[4];
+
+        bool operator==(const Quad &q) const {
+            return child[0] == q.child[0] && child[1] == q.child[1] && child[2] == q.child[2] && child[3] == q.child[3];
+        }
+    };
+
+    std::ostream &out;
+    std::string text;                                    // lines not yet written
+    std::string rowText[256];
+    uint32_t count;                                      // nodes written so far
+    LineTable<uint64_t> leaves;
+    LineTable<Quad> quads;
+    std::vector<std::vector<uint32_t> > pending;         // upper row per level, waiting for the lower one
+};
+
+
+static void writeMacrocell(std::ostream &out, CAbase &ca, LifeRule rule) {
+    out << "[M2] (Qt_Project_Milestone_04)\n#R " << ruleString(rule) << "\n";
+
+    CAview v = ca.view();
+    int nx = v.getNx(), ny = v.getNy();
+    int level = 3;
+    while ((int64_t(1) << level) < std::max(nx, ny)) level++;
+    int64_t side = int64_t(1) << level;
+
+    MacrocellWriter writer(out);
+    int words = (nx + 63) / 64;
+    std::vector<uint64_t> strip(8 * words);
+    uint32_t root = 0;
+    for (int64_t y = 0; y < side; y += 8) {
+        // leaf b of the strip holds byte b of its 8 bit rows (cells 8b .. 8b + 7)
+        for (int r = 0; r < 8; r++) {
+            if (y + r < ny) v.packRow(int(y + r) + 1, &strip[r * words]);
+            else std::fill(strip.begin() + r * words, strip.begin() + (r + 1) * words, 0);
+        }
+        std::vector<uint32_t> leaves(side / 8, 0);
+        for (int b = 0; b < (nx + 7) / 8; b++) {
+            uint64_t bits = 0;
+            for (int r = 0; r < 8; r++) bits |= ((strip[r * words + b / 8] >> (8 * (b & 7))) & 0xFF) << (8 * r);
+            leaves[b] = writer.leaf(bits);
+        }
+        root = writer.addRow(3, leaves);
+    }
+    // Golly expects a node above the leaves, also for an empty universe
+    if (level == 3 && root != 0) writer.join(4, root, 0, 0, 0);
+    writer.flush(true);
+    if (root == 0) out << std::max(level, 4) << " 0 0 0 0\n";
+}
+
+
+bool readPattern(std::istream &in, int format, CAbase &ca, LifeRule &rule) {
+    /* replace the universe of ca (a binary mode) by a pattern; rule is set to the rule of the file,
+     * Life if it has none; returns false for a malformed file or a pattern larger than getMaxSize(),
+     * leaving ca and rule as they were */
+
+    int mode = ca.getUniverseMode();
+    if (!CAbase::isBinaryMode(mode)) return false;
+
+    // as in readGame, the pattern is decoded into an automaton of its own and adopted once it is complete
+    CAbase next(1, 1);
+    next.setPackedStorage(ca.getPackedStorage());
+    next.setUniverseMode(mode);
+    LifeRule fileRule = makeRule(RULE_LIFE);
+    bool ok = (format == PatternMacrocell) ? readMacrocell(in, next, ca.getNx(), fileRule)
+                                           : readRle(in, next, ca.getNx(), fileRule);
+    if (!ok) return false;
+    next.setSeed(ca.getSeed());
+
+    ca.adoptUniverse(next);
+    rule = fileRule;
+    return true;
+}
+
+
+void writePattern(std::ostream &out, int format, CAbase &ca) {
+    /* the living cells of ca, with the rule of the custom rule mode or the Game of Life */
+
+    LifeRule rule = (ca.getUniverseMode() == 7) ? ca.getRule() : makeRule(RULE_LIFE);
+    if (format == PatternMacrocell) writeMacrocell(out, ca, rule);
+    else writeRle(out, ca, rule);
+}
@@ -0,0 +1,35 @@
+#ifndef PATTERNIO_H
+#define PATTERNIO_H
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include "CAbase.h"
+
+/* Life patterns in the interchange formats of Golly (.rle, .mc)
+ *
+ * RLE stores the bounding box of the living cells as runs of dead ('b') and living ('o') cells,
+ * rows ending with '$', after a header with the size and the rule. Macrocell stores the pattern as
+ * a quadtree: 8x8 leaves drawn with '.' and '*', then one line per node of higher level with the
+ * line numbers of its four quadrants, 0 for empty ones; identical quadrants are written only once.
+ *
+ * Both are parsed while they are read and decoded into a universe of their own, which replaces the
+ * one of the automaton (in a binary mode) only once the whole file is read; a malformed file leaves
+ * the automaton and its rule as they were. A pattern is centered in a universe of the current size,
+ * grown to the size of the pattern if it is smaller, up to getMaxSize().
+ */
+
+enum patternFormats {
+    PatternRle,
+    PatternMacrocell
+};
+
+
+int patternFormatOfFile(const std::string &filename);
+
+bool readPattern(std::istream &in, int format, CAbase &ca, LifeRule &rule);
+
+void writePattern(std::ostream &out, int format, CAbase &ca);
+
+
+#endif // PATTERNIO_H
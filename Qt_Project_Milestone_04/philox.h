@@ -0,0 +1,56 @@
+#ifndef PHILOX_H
+#define PHILOX_H
+
+#include <stdint.h>
+
+/* Counter-based random numbers (Philox4x32-10, Salmon et al., SC 2011)
+ *
+ * The generator has no state: ten rounds of multiplications and key additions scramble a 128-bit
+ * counter under a 64-bit key. Keying on the seed and counting on (generation, x, y, purpose) gives
+ * every cell and generation its own independent numbers, so the result neither depends on the order
+ * in which the cells are visited nor on the thread that visits them.
+ */
+
+inline void philoxRound(uint32_t c[4], const uint32_t k[2]) {
+    const uint64_t p0 = uint64_t(0xD2511F53u) * c[0];
+    const uint64_t p1 = uint64_t(0xCD9E8D57u) * c[2];
+    uint32_t c0 = uint32_t(p1 >> 32) ^ c[1] ^ k[0];
+    uint32_t c2 = uint32_t(p0 >> 32) ^ c[3] ^ k[1];
+    c[1] = uint32_t(p1);
+    c[3] = uint32_t(p0);
+    c[0] = c0;
+    c[2] = c2;
+}
+
+
+inline uint64_t philox(uint64_t seed, uint64_t generation, uint32_t x, uint32_t y, uint32_t purpose) {
+    /* 64 random bits for the counter (generation, x, y, purpose) under the key seed; purpose < 256 */
+
+    uint32_t c[4] = {x, y, uint32_t(generation), uint32_t(generation >> 32) << 8 | (purpose & 0xff)};
+    uint32_t k[2] = {uint32_t(seed), uint32_t(seed >> 32)};
+    for (int round = 0; round < 10; round++) {
+        if (round > 0) {
+            k[0] += 0x9E3779B9u;
+            k[1] += 0xBB67AE85u;
+        }
+        philoxRound(c, k);
+    }
+    return (uint64_t(c[0]) << 32) | c[1];
+}
+
+
+inline int philoxBelow(uint64_t r, int n) {
+    /* map random bits to 0 .. n - 1 without the modulo bias of r % n */
+    return int(((r >> 32) * uint64_t(n)) >> 32);
+}
+
+
+inline uint64_t philoxBelow64(uint64_t r, uint64_t n) {
+    /* the same for any 64-bit n, such as a count of cells: ((r >> 32) * n) >> 32 without overflow */
+
+    uint64_t t = r >> 32;
+    return t * (n >> 32) + ((t * (n & 0xFFFFFFFFu)) >> 32);
+}
+
+
+#endif // PHILOX_H
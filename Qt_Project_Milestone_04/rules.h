@@ -0,0 +1,102 @@
+#ifndef RULES_H
+#define RULES_H
+
+#include <stdint.h>
+#include <string>
+
+/* Outer-totalistic (Life-like) rules in B/S notation
+ *
+ * A rule is a pair of 9-bit masks: bit n of birth is set if a dead cell with n living neighbours
+ * comes alive, bit n of survival if a living cell with n living neighbours stays alive. "B3/S23"
+ * is the Game of Life. The parser is constexpr, so built-in rules become template arguments of
+ * the row kernels and are folded into their boolean network at compile time.
+ */
+
+struct LifeRule {
+    uint16_t birth;
+    uint16_t survival;
+};
+
+
+constexpr bool ruleIsLetter(char c, char letter) {
+    return c == letter || c == letter + ('a' - 'A');
+}
+
+
+constexpr uint16_t ruleDigits(const char *s) {
+    // neighbour counts up to the next non-digit
+    return (*s >= '0' && *s <= '8') ? uint16_t((1u << (*s - '0')) | ruleDigits(s + 1)) : uint16_t(0);
+}
+
+
+constexpr const char *ruleFind(const char *s, char letter) {
+    // position after the given letter, or the end of the string
+    return *s == 0 ? s : (ruleIsLetter(*s, letter) ? s + 1 : ruleFind(s + 1, letter));
+}
+
+
+constexpr uint16_t ruleBirthMask(const char *rule) {
+    return ruleDigits(ruleFind(rule, 'B'));
+}
+
+
+constexpr uint16_t ruleSurvivalMask(const char *rule) {
+    return ruleDigits(ruleFind(rule, 'S'));
+}
+
+
+constexpr LifeRule makeRule(const char *rule) {
+    return LifeRule{ruleBirthMask(rule), ruleSurvivalMask(rule)};
+}
+
+
+inline int ruleCell(LifeRule rule, int alive, int n) {
+    /* next state of a cell with n living neighbours */
+    return ((alive ? rule.survival : rule.birth) >> n) & 1;
+}
+
+
+inline bool parseRule(const std::string &text, LifeRule &rule) {
+    /* strict B/S parser for user input ("B36/S23", case insensitive); returns false if malformed */
+
+    size_t slash = text.find('/');
+    if (slash == std::string::npos || text.size() < 3) return false;
+    if (!ruleIsLetter(text[0], 'B') || slash + 1 >= text.size() || !ruleIsLetter(text[slash + 1], 'S')) return false;
+
+    for (size_t i = 1; i < text.size(); i++) {
+        if (i == slash || i == slash + 1) continue;
+        if (text[i] < '0' || text[i] > '8') return false;
+    }
+    rule = makeRule(text.c_str());
+    return true;
+}
+
+
+inline std::string ruleString(LifeRule rule) {
+    std::string s = "B";
+    for (int n = 0; n <= 8; n++) {
+        if ((rule.birth >> n) & 1) s += char('0' + n);
+    }
+    s += "/S";
+    for (int n = 0; n <= 8; n++) {
+        if ((rule.survival >> n) & 1) s += char('0' + n);
+    }
+    return s;
+}
+
+
+// rules with a compiled kernel of their own
+#define RULE_LIFE "B3/S23"
+#define RULE_FLUIDS "B4678/S4678" // alive with exactly four or more than five neighbours
+#define RULE_HIGHLIFE "B36/S23"
+#define RULE_DAYNIGHT "B3678/S34678"
+#define RULE_SEEDS "B2/S"
+#define RULE_NODEATH "B3/S012345678"
+#define RULE_MAZE "B3/S12345"
+#define RULE_REPLICATOR "B1357/S1357"
+#define RULE_2X2 "B36/S125"
+#define RULE_MORLEY "B368/S245"
+#define RULE_ANNEAL "B4678/S35678"
+
+
+#endif // RULES_H
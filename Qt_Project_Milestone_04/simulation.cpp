@@ -0,0 +1,249 @@
+#include <algorithm>
+#include <cmath>
+#include <QMutexLocker>
+#include "simulation.h"
+
+
+Simulation::Access::Access(Simulation &s) :
+    sim(s)
+{
+    // the worker yields the automaton after its current generation
+    sim.guiWaiting.ref();
+    sim.mutex.lock();
+}
+
+
+Simulation::Access::~Access() {
+    sim.guiWaiting.deref();
+    sim.mutex.unlock();
+    sim.wake.wakeAll();
+}
+
+
+Simulation::Simulation(CAbase &automaton, QObject *parent) :
+    QThread(parent),
+    ca(automaton),
+    evolving(false),
+    frameWanted(true),
+    quit(false),
+    remaining(-1),
+    jump(0),
+    jumpStep(1),
+    interval(300),
+    viewX(0),
+    viewY(0),
+    viewZoom(1),
+    viewWidth(1),
+    viewHeight(1)
+{
+    frameClock.start();
+    start();
+}
+
+
+Simulation::~Simulation() {
+    {
+        QMutexLocker locker(&mutex);
+        quit = true;
+    }
+    wake.wakeAll();
+    wait();
+}
+
+
+void Simulation::startEvolution(int generations) {
+    /* evolve the given number of generations, or endlessly for a negative number */
+
+    Access access(*this);
+    evolving = true;
+    remaining = generations;
+    clock.start();
+}
+
+
+void Simulation::stopEvolution() {
+    /* stop the evolution, and a jump that is still running */
+
+    Access access(*this);
+    evolving = false;
+    jump = 0;
+    // the GUI may not have taken the last generations yet
+    access.modified();
+}
+
+
+bool Simulation::isEvolving() {
+    Access access(*this);
+    return evolving;
+}
+
+
+int Simulation::getInterval() {
+    /* return time interval between two consecutive generations [msec]*/
+    Access access(*this);
+    return interval;
+}
+
+
+void Simulation::setInterval(int msec) {
+    /* set interval between generations, 0 for as fast as possible */
+    Access access(*this);
+    interval = msec;
+}
+
+
+void Simulation::jumpGenerations(quint64 n) {
+    /* advance the Game of Life by n generations at once, on the worker */
+
+    Access access(*this);
+    if (jump == 0) jumpStep = 1;
+    jump += n;
+}
+
+
+void Simulation::setViewport(double x, double y, double zoom, int w, int h) {
+    /* the part of the universe the widget shows: cell coordinates of its top left corner, pixels per
+     * cell and size in pixels; only the visible cells are rendered */
+
+    Access access(*this);
+    viewX = x;
+    viewY = y;
+    viewZoom = zoom;
+    viewWidth = std::max(w, 1);
+    viewHeight = std::max(h, 1);
+    access.modified();
+}
+
+
+void Simulation::run() {
+    /* worker loop: evolve, render and wait, holding the automaton except while waiting
+     *
+     * The GUI gets the automaton while the worker waits for the next generation or for work, and
+     * after every generation if an Access is waiting, so that the two take turns.
+     */
+
+    QMutexLocker locker(&mutex);
+    while (!quit) {
+        if (jump > 0) {
+            if (ca.getBorderMode() == CAbase::BorderTorus) {
+                // HashLife only knows periodic universes; its memory of the pattern lasts from step to step
+                quint64 n = std::min(jump, jumpStep);
+                QElapsedTimer step;
+                step.start();
+                hashLife.jump(ca, n);
+                jump -= n;
+                jumpStep = (step.elapsed() < frameInterval) ? 2 * jumpStep : std::max(jumpStep / 2, quint64(1));
+            } else {
+                // whole periods are skipped at once as soon as a cycle is known
+                quint64 n = (ca.getCyclePeriod() > 0) ? jump : 1;
+                jump = (ca.evolveGenerations(n) < n) ? 0 : jump - n;
+            }
+            if (jump == 0 || (frames.taken() && frameClock.elapsed() >= frameInterval)) frameWanted = true;
+            if (frameWanted) render();
+            if (guiWaiting.loadAcquire() > 0) wake.wait(&mutex);
+            continue;
+        }
+        if (!evolving) {
+            if (frameWanted) render();
+            else wake.wait(&mutex);
+            continue;
+        }
+        qint64 due = interval - clock.elapsed();
+        if (due > 0) {
+            if (frameWanted) render();
+            else wake.wait(&mutex, (unsigned long) due);
+            continue;
+        }
+        clock.start();
+
+        ca.worldEvolution();
+        evolved.fetchAndAddRelease(1);
+
+        int reason = -1;
+        if (ca.isNotChanged()) {
+            reason = HaltNoChanges;
+        } else if (ca.getCyclePeriod() > 0) {
+            // blinkers and other oscillators would keep the evolution running for nothing
+            reason = HaltPeriodic;
+        } else if (remaining > 0 && --remaining == 0) {
+            reason = HaltFinished;
+        }
+        if (reason >= 0) {
+            evolving = false;
+            frameWanted = true;
+            emit halted(reason, qulonglong(ca.getCyclePeriod()), qulonglong(ca.getCycleStart()));
+        }
+        // render only once the GUI has painted the previous frame, at most every frameInterval
+        if (frames.taken() && frameClock.elapsed() >= frameInterval) frameWanted = true;
+        if (frameWanted) render();
+
+        // a waiting Access of the GUI gets the automaton before the next generation
+        if (guiWaiting.loadAcquire() > 0) wake.wait(&mutex);
+    }
+}
+
+
+void Simulation::render() {
+    /* copy the visible cells of the current generation into the next frame and hand it to the GUI
+     *
+     * The cells are copied row by row into an indexed 8-bit image, whose palette the GUI maps to the
+     * colors of the cell values. If a cell is smaller than a pixel, every pixel holds the share of
+     * occupied cells it covers instead (0 .. 255), so the image never has more pixels than the
+     * widget. Each pixel row then reads at most densityRows evenly spread rows of the band of cells
+     * it covers: beyond densityRows rows per pixel the share is estimated from these samples, not
+     * counted over the whole band, so thin horizontal structures between them do not show. Either
+     * way the cost of a frame depends on the size of the widget, not on the size of the universe.
+     */
+
+    frameWanted = false;
+    frameClock.start();
+    SimulationFrame &f = frames.writeSlot();
+    CAview v = ca.view();
+    int nx = v.getNx(), ny = v.getNy();
+
+    // visible cells, counted from 0
+    int x0 = std::max(0, int(std::floor(viewX)));
+    int y0 = std::max(0, int(std::floor(viewY)));
+    int x1 = std::min(nx, int(std::ceil(viewX + viewWidth / viewZoom)));
+    int y1 = std::min(ny, int(std::ceil(viewY + viewHeight / viewZoom)));
+
+    f.generation = ca.getGeneration();
+    f.cells = QRect(x0, y0, std::max(x1 - x0, 0), std::max(y1 - y0, 0));
+    f.density = (viewZoom < 1);
+    if (f.cells.isEmpty()) {
+        f.image = QImage();
+    } else if (!f.density) {
+        if (f.image.width() != f.cells.width() || f.image.height() != f.cells.height()) {
+            f.image = QImage(f.cells.width(), f.cells.height(), QImage::Format_Indexed8);
+        }
+        for (int k = y0; k < y1; k++) {
+            v.renderRow(k + 1, x0 + 1, x1 - x0, f.image.scanLine(k - y0));
+        }
+    } else {
+        // density level of detail: one pixel per group of cells
+        int columns = std::max(1, std::min(x1 - x0, int(std::ceil((x1 - x0) * viewZoom))));
+        int rows = std::max(1, std::min(y1 - y0, int(std::ceil((y1 - y0) * viewZoom))));
+        if (f.image.width() != columns || f.image.height() != rows) {
+            f.image = QImage(columns, rows, QImage::Format_Indexed8);
+        }
+        densityCount.resize(columns);
+        for (int r = 0; r < rows; r++) {
+            int r0 = y0 + int((qint64) r * (y1 - y0) / rows);
+            int r1 = y0 + int((qint64) (r + 1) * (y1 - y0) / rows);
+            // tall bands are sampled at densityRows evenly spread rows, an estimate of their share
+            int samples = std::min(r1 - r0, int(densityRows));
+            std::fill(densityCount.begin(), densityCount.end(), 0);
+            for (int i = 0; i < samples; i++) {
+                v.countRow(r0 + i * (r1 - r0) / samples + 1, x0 + 1, x1, columns, densityCount.data());
+            }
+            uchar *out = f.image.scanLine(r);
+            for (int c = 0; c < columns; c++) {
+                int c0 = int((qint64) c * (x1 - x0) / columns);
+                int c1 = int((qint64) (c + 1) * (x1 - x0) / columns);
+                out[c] = uchar(densityCount[c] * 255 / ((c1 - c0) * samples));
+            }
+        }
+    }
+    frames.publish();
+    emit frameReady();
+}
@@ -0,0 +1,141 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <QAtomicInt>
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+#include <QImage>
+#include <QMutex>
+#include <QRect>
+#include <QThread>
+#include <QWaitCondition>
+#include <vector>
+#include "CAbase.h"
+#include "hashlife.h"
+#include "triplebuffer.h"
+
+
+struct SimulationFrame {
+    /* a finished generation, ready to be painted */
+
+    SimulationFrame() :
+        density(false),
+        generation(0)
+        {}
+
+    QImage image;         // indexed pixels: cell values, or shares of occupied cells if density
+    bool density;         // one pixel per group of cells (cells smaller than a pixel)
+    QRect cells;          // cells covered by the image, counted from 0
+    quint64 generation;
+};
+
+
+class Simulation : public QThread {
+    /* evolution of the automaton on a worker thread
+     *
+     * The worker evolves the automaton at the given interval (or as fast as the core allows for 0) and
+     * hands finished generations to the GUI through a triple buffer. A new frame is only rendered once
+     * the GUI has taken the previous one and at least frameInterval msec after the last one, so the
+     * worker never renders more frames than are painted and evolves in between as fast as it can.
+     *
+     * Jumps ahead run on the worker as well, in steps after which the GUI gets the automaton: single
+     * generations, or on the torus HashLife jumps whose length doubles as long as one takes less
+     * than frameInterval.
+     *
+     * The GUI thread touches the automaton only through an Access, which holds the worker between two
+     * generations; every other member may be called from the GUI thread at any time.
+     */
+
+    Q_OBJECT
+
+public:
+    enum halts {
+        HaltNoChanges,  // all future generations are identical, or the snake died
+        HaltPeriodic,   // the evolution repeats itself
+        HaltFinished    // the requested number of generations is done
+    };
+
+    class Access {
+        /* exclusive access to the automaton from the GUI thread, for the lifetime of the object */
+
+    public:
+        explicit Access(Simulation &s);
+        ~Access();
+
+        void modified() {
+            // the universe changed: render a new frame
+            sim.frameWanted = true;
+        }
+
+    private:
+        Simulation &sim;
+    };
+
+    explicit Simulation(CAbase &automaton, QObject *parent = 0);
+    ~Simulation();
+
+    void startEvolution(int generations = -1);
+    void stopEvolution();
+    bool isEvolving();
+
+    int getInterval();
+    void setInterval(int msec);
+
+    void jumpGenerations(quint64 n);
+
+    void setViewport(double x, double y, double zoom, int w, int h);
+
+    quint64 getEvolved() {
+        // generations evolved by the worker so far, for the rate of the evolution
+        return evolved.loadAcquire();
+    }
+
+    bool takeFrame() {
+        // GUI thread: make the newest finished frame the current one; false if there is none
+        return frames.take();
+    }
+
+    SimulationFrame &frame() {
+        // GUI thread: current frame
+        return frames.readSlot();
+    }
+
+signals:
+    void frameReady();
+    void halted(int reason, qulonglong period, qulonglong start);
+
+protected:
+    void run();
+
+private:
+    void render();
+
+    static const int densityRows = 8;     // rows of cells sampled per pixel row when zoomed out
+    static const int frameInterval = 16;  // msec between two frames at least (60 frames per second)
+
+    CAbase &ca;
+    HashLife hashLife;         // jumps of the Game of Life on the torus
+    QMutex mutex;              // guards the automaton and the settings below
+    QWaitCondition wake;
+    QAtomicInt guiWaiting;     // Access objects waiting for the automaton
+    QElapsedTimer clock;       // time since the last generation
+    QElapsedTimer frameClock;  // time since the last frame
+    QAtomicInteger<quint64> evolved;
+    TripleBuffer<SimulationFrame> frames;
+    std::vector<uint32_t> densityCount;  // occupied cells per pixel of the current row
+    bool evolving;
+    bool frameWanted;
+    bool quit;
+    int remaining;             // generations until HaltFinished, negative for endless evolution
+    quint64 jump;              // generations still to jump ahead, 0 if none
+    quint64 jumpStep;          // generations of the next HashLife step
+    int interval;              // msec between two generations
+    double viewX;              // cell coordinate (from 0) of the left edge of the widget
+    double viewY;              // cell coordinate of the top edge
+    double viewZoom;           // pixels per cell
+    int viewWidth;             // size of the widget in pixels
+    int viewHeight;
+};
+
+
+#endif // SIMULATION_H
@@ -0,0 +1,100 @@
+#include <cstdio>
+#include <vector>
+
+#include "CAbase.h"
+
+/* Tests of the cellular automata core
+ *
+ * Every test prints its name and whether it passed; the exit status is the number of failed tests,
+ * so that make check fails with any of them.
+ *
+ * usage: ca_tests
+ */
+
+static int failures = 0;
+
+
+static void check(bool ok, const char *name) {
+    printf("%-56s %s\n", name, ok ? "ok" : "FAILED");
+    if (!ok) failures++;
+}
+
+
+static void populatePredator(CAbase &ca, int n, int lifetime) {
+    /* predators, prey and food drawn from the seed of the automaton, as the CLI does */
+
+    for (int y = 1; y <= n; y++) {
+        for (int x = 1; x <= n; x++) {
+            int kind = philoxBelow(ca.cellRandom(x, y, CAbase::RandomNoise), 10);
+            if (kind == 0) {
+                ca.setValue(x, y, 1);
+                ca.setLifetime(x, y, lifetime);
+            } else if (kind <= 2) {
+                ca.setValue(x, y, 2);
+                ca.setLifetime(x, y, lifetime);
+            } else if (kind == 3) {
+                ca.setValue(x, y, 5);
+            }
+        }
+    }
+}
+
+
+struct PredatorRun {
+    std::vector<int> cells;      // value and lifetime of every cell, row by row
+    int population[6];           // cells of every value
+};
+
+
+static PredatorRun runPredator(int threads, int n, int generations) {
+    /* evolve a seeded predator-prey universe with the given number of threads */
+
+    CAbase ca;
+    ca.setThreadCount(threads);
+    ca.setSeed(20240611);
+    ca.lifeTimeUI = 50;
+    ca.setUniverseMode(2);
+    ca.resetWorldSize(n, n);
+    populatePredator(ca, n, ca.lifeTimeUI);
+    for (int g = 0; g < generations; g++) ca.worldEvolution();
+
+    PredatorRun run;
+    for (int v = 0; v < 6; v++) run.population[v] = 0;
+    for (int y = 1; y <= n; y++) {
+        for (int x = 1; x <= n; x++) {
+            int v = ca.getValue(x, y);
+            run.cells.push_back(v);
+            run.cells.push_back(ca.getLifetime(x, y));
+            if (v >= 0 && v < 6) run.population[v]++;
+        }
+    }
+    return run;
+}
+
+
+static void testPredatorThreads() {
+    /* claim and resolve: the same seed evolves to the same universe with any number of threads */
+
+    const int n = 257;
+    const int generations = 30;    // predators and prey both still alive
+    PredatorRun single = runPredator(1, n, generations);
+    check(single.population[1] > 0 && single.population[2] > 0, "predator: predators and prey still alive");
+
+    const int threadCounts[] = {4, 16};
+    for (int t : threadCounts) {
+        PredatorRun multi = runPredator(t, n, generations);
+        bool samePopulation = true;
+        for (int v = 0; v < 6; v++) samePopulation = samePopulation && multi.population[v] == single.population[v];
+        char name[80];
+        snprintf(name, sizeof(name), "predator: populations with 1 and %d threads", t);
+        check(samePopulation, name);
+        snprintf(name, sizeof(name), "predator: worlds with 1 and %d threads", t);
+        check(multi.cells == single.cells, name);
+    }
+}
+
+
+int main() {
+    testPredatorThreads();
+    return failures;
+}
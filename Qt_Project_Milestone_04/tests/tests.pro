@@ -0,0 +1,28 @@
+#-------------------------------------------------
+#
+# Tests of the cellular automata core (no Qt), run by make check
+#
+#-------------------------------------------------
+
+CONFIG   += console c++11 thread testcase
+CONFIG   -= qt app_bundle
+
+TARGET = ca_tests
+TEMPLATE = app
+
+INCLUDEPATH += ..
+
+gcc: QMAKE_CXXFLAGS += -Wno-psabi
+
+SOURCES += \
+        main.cpp
+
+HEADERS += \
+        ../CAbase.h \
+        ../arena.h \
+        ../bitplane.h \
+        ../lifekernel.h \
+        ../philox.h \
+        ../rules.h \
+        ../threadpool.h \
+        ../zobrist.h
@@ -0,0 +1,138 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <stdint.h>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+    /* persistent worker threads for data-parallel loops
+     *
+     * parallelFor splits a range into one contiguous band per thread. The calling thread works on the
+     * first band itself and returns once every band is done, so a loop costs two condition variable
+     * round trips instead of thread creation.
+     */
+
+public:
+    explicit ThreadPool(int threads = 1) :
+        bands(0),
+        generation(0),
+        pending(0),
+        quit(false)
+        { start(threads); }
+
+    ~ThreadPool() {
+        stop();
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    int getThreadCount() const {
+        return int(workers.size()) + 1;
+    }
+
+    void setThreadCount(int threads) {
+        if (threads == getThreadCount()) return;
+        stop();
+        start(threads);
+    }
+
+    template <class F>
+    void parallelFor(int begin, int end, F body);
+
+private:
+    void start(int threads);
+    void stop();
+    void workerLoop(int id);
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::function<void(int)> task;
+    int bands;
+    uint64_t generation;
+    int pending;
+    bool quit;
+};
+
+
+inline void ThreadPool::start(int threads) {
+    /* spawn threads - 1 workers; the caller of parallelFor is the last thread */
+
+    quit = false;
+    for (int id = 1; id < threads; id++) {
+        workers.push_back(std::thread(&ThreadPool::workerLoop, this, id));
+    }
+}
+
+
+inline void ThreadPool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake.notify_all();
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i].join();
+    }
+    workers.clear();
+}
+
+
+inline void ThreadPool::workerLoop(int id) {
+    uint64_t seen = 0;
+    for (;;) {
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [&] { return quit || generation != seen; });
+        if (quit) return;
+        seen = generation;
+        if (id >= bands) continue;
+        lock.unlock();
+
+        task(id);
+
+        lock.lock();
+        if (--pending == 0) done.notify_one();
+    }
+}
+
+
+template <class F>
+inline void ThreadPool::parallelFor(int begin, int end, F body) {
+    /* call body(bandBegin, bandEnd, band) for contiguous bands covering begin .. end - 1 */
+
+    int n = end - begin;
+    int count = getThreadCount() < n ? getThreadCount() : n;
+    if (count <= 1) {
+        if (n > 0) body(begin, end, 0);
+        return;
+    }
+
+    // band b covers an equal share of the range, the first n % count bands one element more
+    auto band = [&](int b) {
+        int b0 = begin + b * (n / count) + (b < n % count ? b : n % count);
+        int b1 = b0 + n / count + (b < n % count ? 1 : 0);
+        body(b0, b1, b);
+    };
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        task = band;
+        bands = count;
+        pending = count - 1;
+        generation++;
+    }
+    wake.notify_all();
+
+    band(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&] { return pending == 0; });
+}
+
+
+#endif // THREADPOOL_H
@@ -0,0 +1,64 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <atomic>
+
+template <class T>
+class TripleBuffer {
+    /* lock-free hand-over of the newest value from one writer thread to one reader thread
+     *
+     * The writer and the reader each own one of three slots, the third one lies in between. publish()
+     * swaps the written slot with the one in between and marks it fresh, take() swaps the read slot
+     * with a fresh one in between. Neither side ever waits; the reader always gets the newest
+     * published value, and values that were never taken are simply written over.
+     */
+
+public:
+    TripleBuffer() :
+        front(0),
+        middle(1),
+        back(2)
+        {}
+
+    TripleBuffer(const TripleBuffer &) = delete;
+    TripleBuffer &operator=(const TripleBuffer &) = delete;
+
+    T &writeSlot() {
+        // writer only
+        return slots[back];
+    }
+
+    void publish() {
+        // writer only: hand the write slot over to the reader
+        back = middle.exchange(back | freshBit, std::memory_order_acq_rel) & indexMask;
+    }
+
+    bool taken() const {
+        // whether the reader has taken the last published value
+        return !(middle.load(std::memory_order_acquire) & freshBit);
+    }
+
+    bool take() {
+        // reader only: make the newest published value the read slot; false if there is none
+        if (taken()) return false;
+        front = middle.exchange(front, std::memory_order_acq_rel) & indexMask;
+        return true;
+    }
+
+    T &readSlot() {
+        // reader only
+        return slots[front];
+    }
+
+private:
+    static const int indexMask = 3;
+    static const int freshBit = 4;
+
+    T slots[3];
+    int front;                // slot of the reader
+    std::atomic<int> middle;  // slot in between, plus freshBit if it was published and not taken
+    int back;                 // slot of the writer
+};
+
+
+#endif // TRIPLEBUFFER_H
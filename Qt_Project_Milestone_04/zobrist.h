@@ -0,0 +1,21 @@
+#ifndef ZOBRIST_H
+#define ZOBRIST_H
+
+#include <stdint.h>
+
+/* Zobrist hashing of a universe
+ *
+ * The hash of a universe is the XOR of one random key per word of cells, the key depending on the
+ * position of the word and the cells it holds. A generation only rehashes the rows that changed, in
+ * any order and on any thread. The keys are not stored but computed from position and contents.
+ */
+
+inline uint64_t zobristWord(uint64_t index, uint64_t word) {
+    /* key of word index holding the cells word; two multiplications, as every changed row is rehashed */
+    uint64_t z = (word ^ (index * 0x9E3779B97F4A7C15ULL)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 32)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 29);
+}
+
+
+#endif // ZOBRIST_H